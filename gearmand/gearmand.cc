@@ -81,6 +81,8 @@
 #include <boost/tokenizer.hpp>
 
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include "libtest/cpu.hpp"
 
@@ -132,6 +134,17 @@ int main(int argc, char *argv[])
   int opt_keepalive_idle;
   int opt_keepalive_interval;
   int opt_keepalive_count;
+  bool opt_background_replay;
+  std::string spill_file;
+  uint64_t memory_budget;
+  uint32_t spill_prefetch;
+  std::string scheduler;
+  std::string priority_weights;
+  uint32_t priority_aging;
+  std::vector<std::string> max_running;
+  uint32_t retry_backoff;
+  uint32_t retry_backoff_max;
+  std::string dead_letter_function;
 
 
   boost::program_options::options_description general("General options");
@@ -154,6 +167,15 @@ int main(int argc, char *argv[])
   ("job-retries,j", boost::program_options::value(&job_retries)->default_value(0),
    "Number of attempts to run the job before the job server removes it. This is helpful to ensure a bad job does not crash all available workers. Default is no limit.")
 
+  ("retry-backoff", boost::program_options::value(&retry_backoff)->default_value(0),
+   "Seconds to wait before running a job again after its worker failed, doubled for every further retry. 0 requeues the job at once. The retrybackoff admin command changes it per function.")
+
+  ("retry-backoff-max", boost::program_options::value(&retry_backoff_max)->default_value(GEARMAND_DEFAULT_RETRY_BACKOFF_MAX),
+   "Longest wait in seconds between two runs of a job with --retry-backoff.")
+
+  ("dead-letter-function", boost::program_options::value(&dead_letter_function),
+   "Queue jobs that ran out of --job-retries for this function instead of dropping them.")
+
   ("job-handle-prefix", boost::program_options::value(&job_handle_prefix),
    "Prefix used to generate a job handle string. If not provided, the default \"H:<host_name>\" is used.")
 
@@ -189,6 +211,30 @@ int main(int argc, char *argv[])
   ("queue-type,q", boost::program_options::value(&queue_type)->default_value("builtin"),
    "Persistent queue type to use.")
 
+  ("background-replay", boost::program_options::bool_switch(&opt_background_replay)->default_value(false),
+   "Load the persistent queue in the background while already accepting work. Background jobs submitted before the load has read the whole queue wait for it.")
+
+  ("scheduler", boost::program_options::value(&scheduler)->default_value("priority"),
+   "How workers get jobs: priority always drains higher priorities first, fair uses weighted round robin across priorities and functions.")
+
+  ("priority-weights", boost::program_options::value(&priority_weights)->default_value("4,2,1"),
+   "Jobs taken from the high, normal and low priority queues of a function per round with --scheduler=fair.")
+
+  ("priority-aging", boost::program_options::value(&priority_aging)->default_value(0),
+   "With --scheduler=fair, run a job that waited this many seconds before any other, 0 disables aging.")
+
+  ("max-running", boost::program_options::value(&max_running)->composing(),
+   "Run at most N jobs of a function at a time, given as FUNCTION=N. May be repeated, the maxrunning admin command changes it at runtime.")
+
+  ("spill-file", boost::program_options::value(&spill_file),
+   "Write the payloads of queued jobs to this file once the memory budget is exceeded. The file is removed as soon as it is opened.")
+
+  ("memory-budget", boost::program_options::value(&memory_budget)->default_value(0),
+   "Bytes of job payload to keep in memory before spilling to --spill-file, 0 means only the per function budgets set with the memorybudget admin command apply.")
+
+  ("spill-prefetch", boost::program_options::value(&spill_prefetch)->default_value(16),
+   "Number of jobs ahead of the next one to be taken whose spilled payloads are read back in the background, 0 disables prefetching.")
+
   ("config-file", boost::program_options::value(&config_file)->default_value(GEARMAND_CONFIG),
    "Can be specified with '@name', too")
 
@@ -315,6 +361,53 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
   }
 
+  if (scheduler.compare("priority") and scheduler.compare("fair"))
+  {
+    error::message("--scheduler must be priority or fair");
+    return EXIT_FAILURE;
+  }
+
+  uint32_t high_weight, normal_weight, low_weight;
+  char weights_trailer;
+  if (sscanf(priority_weights.c_str(), "%u,%u,%u%c", &high_weight, &normal_weight, &low_weight, &weights_trailer) != 3 or
+      high_weight == 0 or normal_weight == 0 or low_weight == 0)
+  {
+    error::message("--priority-weights takes three weights of at least 1, for example 4,2,1");
+    return EXIT_FAILURE;
+  }
+
+  if (memory_budget and spill_file.empty())
+  {
+    error::message("--memory-budget requires --spill-file");
+    return EXIT_FAILURE;
+  }
+
+  if (dead_letter_function.size() >= GEARMAN_FUNCTION_MAX_SIZE)
+  {
+    error::message("--dead-letter-function is too long");
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::pair<std::string, uint32_t> > max_running_limits;
+  for (std::vector<std::string>::const_iterator iter= max_running.begin(); iter != max_running.end(); ++iter)
+  {
+    size_t separator= iter->rfind('=');
+    char *end= NULL;
+    unsigned long limit= 0;
+    if (separator != std::string::npos)
+    {
+      limit= strtoul(iter->c_str() +separator +1, &end, 10);
+    }
+
+    if (separator == std::string::npos or separator == 0 or
+        end == iter->c_str() +separator +1 or *end != 0 or limit > UINT32_MAX)
+    {
+      error::message("--max-running takes FUNCTION=N, for example resize=4");
+      return EXIT_FAILURE;
+    }
+    max_running_limits.push_back(std::make_pair(iter->substr(0, separator), uint32_t(limit)));
+  }
+
   if (opt_check_args)
   {
     return EXIT_SUCCESS;
@@ -392,6 +485,23 @@ int main(int argc, char *argv[])
 
   gearmand_config_sockopt_keepalive_interval(gearmand_config, opt_keepalive_interval);
 
+  gearmand_config_background_replay(gearmand_config, opt_background_replay);
+
+  gearmand_config_scheduler(gearmand_config, scheduler.c_str(),
+                            high_weight, normal_weight, low_weight,
+                            priority_aging);
+
+  gearmand_config_spill(gearmand_config, spill_file.c_str(), memory_budget, spill_prefetch);
+
+  gearmand_config_retry(gearmand_config, retry_backoff, retry_backoff_max, dead_letter_function.c_str());
+
+  for (std::vector<std::pair<std::string, uint32_t> >::const_iterator iter= max_running_limits.begin();
+       iter != max_running_limits.end();
+       ++iter)
+  {
+    gearmand_config_max_running(gearmand_config, iter->first.c_str(), iter->second);
+  }
+
   gearmand_st *_gearmand= gearmand_create(gearmand_config,
                                           host.empty() ? NULL : host.c_str(),
                                           threads, backlog,
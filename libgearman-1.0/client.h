@@ -61,6 +61,20 @@ enum gearman_client_t {
   GEARMAN_CLIENT_STATE_PACKET
 };
 
+/**
+ * One job of a gearman_client_do_background_batch() call. The caller fills in
+ * the first five members, the library fills in ret and job_handle.
+ */
+struct gearman_batch_job_t {
+  const char *function_name;
+  const char *unique;
+  const void *workload;
+  size_t workload_size;
+  gearman_job_priority_t priority;
+  gearman_return_t ret;
+  gearman_job_handle_t job_handle;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -396,6 +410,61 @@ gearman_return_t gearman_client_do_low_background(gearman_client_st *client,
                                                   size_t workload_size,
                                                   gearman_job_handle_t job_handle);
 
+/**
+ * Submit several background jobs with a single SUBMIT_JOB_BATCH request. The
+ * jobs are sent to one server, which stores them with one call to its queue
+ * and answers with all of the job handles at once.
+ *
+ * @param[in] client Structure previously initialized with
+ *  gearman_client_create() or gearman_client_clone().
+ * @param[in,out] jobs Array of jobs to submit. A NULL unique gets a new UUID.
+ *  On return each job's ret and job_handle are set.
+ * @param[in] count Number of jobs in the array.
+ * @return Standard gearman return value. GEARMAN_SUCCESS means the server
+ *  answered, check each job's ret to see if it was accepted.
+ */
+GEARMAN_API
+gearman_return_t gearman_client_do_background_batch(gearman_client_st *client,
+                                                    gearman_batch_job_t *jobs,
+                                                    size_t count);
+
+/**
+ * Submit a background job without waiting for the server to acknowledge it.
+ * No job handle is returned, and a job the server refuses is only counted,
+ * see gearman_client_noreply_ack().
+ *
+ * @param[in] client Structure previously initialized with
+ *  gearman_client_create() or gearman_client_clone().
+ * @param[in] function_name The name of the function to run.
+ * @param[in] unique Optional unique job identifier, or NULL for a new UUID.
+ * @param[in] workload The workload to pass to the function when it is run.
+ * @param[in] workload_size Size of the workload.
+ * @return Standard gearman return value, GEARMAN_SUCCESS once the job was
+ *  written to a server.
+ */
+GEARMAN_API
+gearman_return_t gearman_client_do_background_noreply(gearman_client_st *client,
+                                                      const char *function_name,
+                                                      const char *unique,
+                                                      const void *workload,
+                                                      size_t workload_size);
+
+/**
+ * Ask every server how many of the jobs sent with
+ * gearman_client_do_background_noreply() it queued and refused since the last
+ * call. The servers reset their counters when answering.
+ *
+ * @param[in] client Structure previously initialized with
+ *  gearman_client_create() or gearman_client_clone().
+ * @param[out] accepted Optional, number of jobs that were queued.
+ * @param[out] refused Optional, number of jobs that were refused.
+ * @return GEARMAN_SUCCESS, or GEARMAN_JOB_QUEUE_FULL if any job was refused.
+ */
+GEARMAN_API
+gearman_return_t gearman_client_noreply_ack(gearman_client_st *client,
+                                            uint64_t *accepted,
+                                            uint64_t *refused);
+
 /**
  * Get the status for a backgound job.
  *
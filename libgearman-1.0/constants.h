@@ -144,6 +144,7 @@ typedef struct gearman_job_st gearman_job_st;
 typedef struct gearman_worker_st gearman_worker_st;
 typedef struct gearman_allocator_t gearman_allocator_t;
 typedef struct gearman_task_attr_t gearman_task_attr_t;
+typedef struct gearman_batch_job_t gearman_batch_job_t;
 typedef struct gearman_result_st gearman_result_st;
 typedef struct gearman_string_t gearman_string_t;
 typedef struct gearman_argument_t gearman_argument_t;
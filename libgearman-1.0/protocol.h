@@ -87,6 +87,13 @@ enum gearman_command_t
   GEARMAN_COMMAND_JOB_ASSIGN_ALL,          /* J->W: HANDLE[0]FUNC[0]UNIQ[0]REDUCER[0]ARGS */
   GEARMAN_COMMAND_GET_STATUS_UNIQUE,          /* C->J: UNIQUE */
   GEARMAN_COMMAND_STATUS_RES_UNIQUE,          /* J->C: UNIQUE[0]KNOWN[0]RUNNING[0]NUM[0]DENOM[0]CLIENT_COUNT */
+  GEARMAN_COMMAND_GRAB_JOB_MULTI,          /* W->J: COUNT */
+  GEARMAN_COMMAND_JOB_ASSIGN_MULTI,          /* J->W: COUNT */
+  GEARMAN_COMMAND_SUBMIT_JOB_BATCH,          /* C->J: COUNT[0]JOBS */
+  GEARMAN_COMMAND_JOB_CREATED_BATCH,          /* J->C: COUNT[0]HANDLES */
+  GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY,          /* C->J: FUNC[0]UNIQ[0]ARGS */
+  GEARMAN_COMMAND_NOREPLY_ACK_REQ,          /* C->J: */
+  GEARMAN_COMMAND_NOREPLY_ACK_RES,          /* J->C: ACCEPTED[0]REFUSED */
   GEARMAN_COMMAND_MAX /* Always add new commands before this. */
 };
 
@@ -440,6 +440,20 @@ GEARMAN_API
   gearman_return_t gearman_worker_set_identifier(gearman_worker_st *worker,
                                                  const char *id, size_t id_size);
 
+/**
+ * Ask the job server for up to count jobs in a single GRAB_JOB_MULTI round
+ * trip. gearman_worker_grab_job() and gearman_worker_work() then hand out the
+ * rest of the batch without asking again. A count of 0 or 1 goes back to
+ * grabbing one job at a time.
+ *
+ * @param[in] worker Structure previously initialized with
+ *  gearman_worker_create() or gearman_worker_clone().
+ * @param[in] count Most jobs to take per request.
+ * @return Standard gearman return value.
+ */
+GEARMAN_API
+  gearman_return_t gearman_worker_set_grab_batch(gearman_worker_st *worker, uint32_t count);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -84,3 +84,52 @@ void gearmand_config_sockopt_keepalive_count(gearmand_config_st *config, int kee
     config->config.sockopt().keepalive_count(keepalive_count_);
   }
 }
+
+void gearmand_config_background_replay(gearmand_config_st *config, bool background_replay_)
+{
+  if (config)
+  {
+    config->config.background_replay(background_replay_);
+  }
+}
+
+void gearmand_config_spill(gearmand_config_st *config, const char *spill_file_, uint64_t memory_budget_, uint32_t prefetch_)
+{
+  if (config)
+  {
+    config->config.spill_file(spill_file_);
+    config->config.memory_budget(memory_budget_);
+    config->config.spill_prefetch(prefetch_);
+  }
+}
+
+void gearmand_config_scheduler(gearmand_config_st *config, const char *scheduler_,
+                               uint32_t high_weight, uint32_t normal_weight, uint32_t low_weight,
+                               uint32_t priority_aging_)
+{
+  if (config)
+  {
+    config->config.scheduler(scheduler_);
+    config->config.priority_weight(GEARMAN_JOB_PRIORITY_HIGH, high_weight);
+    config->config.priority_weight(GEARMAN_JOB_PRIORITY_NORMAL, normal_weight);
+    config->config.priority_weight(GEARMAN_JOB_PRIORITY_LOW, low_weight);
+    config->config.priority_aging(priority_aging_);
+  }
+}
+
+void gearmand_config_max_running(gearmand_config_st *config, const char *function_name, uint32_t max_running_)
+{
+  if (config and function_name)
+  {
+    config->config.max_running(function_name, max_running_);
+  }
+}
+
+void gearmand_config_retry(gearmand_config_st *config, uint32_t backoff, uint32_t backoff_max, const char *dead_letter_function)
+{
+  if (config)
+  {
+    config->config.retry_backoff(backoff, backoff_max);
+    config->config.dead_letter_function(dead_letter_function);
+  }
+}
@@ -65,6 +65,23 @@ GEARMAN_API
 GEARMAN_API
   void gearmand_config_sockopt_keepalive_count(gearmand_config_st *config, int keepalive_count_);
 
+GEARMAN_API
+  void gearmand_config_background_replay(gearmand_config_st *config, bool background_replay_);
+
+GEARMAN_API
+  void gearmand_config_scheduler(gearmand_config_st *config, const char *scheduler_,
+                                 uint32_t high_weight, uint32_t normal_weight, uint32_t low_weight,
+                                 uint32_t priority_aging_);
+
+GEARMAN_API
+  void gearmand_config_max_running(gearmand_config_st *config, const char *function_name, uint32_t max_running_);
+
+GEARMAN_API
+  void gearmand_config_spill(gearmand_config_st *config, const char *spill_file_, uint64_t memory_budget_, uint32_t prefetch_);
+
+GEARMAN_API
+  void gearmand_config_retry(gearmand_config_st *config, uint32_t backoff, uint32_t backoff_max, const char *dead_letter_function);
+
 #ifdef __cplusplus
 }
 #endif
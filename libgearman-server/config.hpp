@@ -39,14 +39,27 @@
 #include "libgearman-server/common.h"
 
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace gearmand {
 
 class Config
 {
 public:
-  Config()
+  Config():
+    _background_replay(false),
+    _memory_budget(0),
+    _spill_prefetch(0),
+    _scheduler("priority"),
+    _priority_aging(0),
+    _retry_backoff(0),
+    _retry_backoff_max(GEARMAND_DEFAULT_RETRY_BACKOFF_MAX)
   {
+    _priority_weights[GEARMAN_JOB_PRIORITY_HIGH]= 4;
+    _priority_weights[GEARMAN_JOB_PRIORITY_NORMAL]= 2;
+    _priority_weights[GEARMAN_JOB_PRIORITY_LOW]= 1;
   }
 
   gearmand_st::SocketOpt& sockopt()
@@ -54,8 +67,125 @@ public:
     return _sockopt;
   }
 
+  bool background_replay() const
+  {
+    return _background_replay;
+  }
+
+  void background_replay(bool background_replay_)
+  {
+    _background_replay= background_replay_;
+  }
+
+  const std::string& spill_file() const
+  {
+    return _spill_file;
+  }
+
+  void spill_file(const char *spill_file_)
+  {
+    _spill_file= spill_file_ ? spill_file_ : "";
+  }
+
+  uint64_t memory_budget() const
+  {
+    return _memory_budget;
+  }
+
+  void memory_budget(uint64_t memory_budget_)
+  {
+    _memory_budget= memory_budget_;
+  }
+
+  uint32_t spill_prefetch() const
+  {
+    return _spill_prefetch;
+  }
+
+  void spill_prefetch(uint32_t spill_prefetch_)
+  {
+    _spill_prefetch= spill_prefetch_;
+  }
+
+  const std::string& scheduler() const
+  {
+    return _scheduler;
+  }
+
+  void scheduler(const char *scheduler_)
+  {
+    _scheduler= scheduler_ ? scheduler_ : "";
+  }
+
+  const uint32_t (&priority_weights() const)[GEARMAN_JOB_PRIORITY_MAX]
+  {
+    return _priority_weights;
+  }
+
+  void priority_weight(gearman_job_priority_t priority, uint32_t weight)
+  {
+    _priority_weights[priority]= weight;
+  }
+
+  uint32_t priority_aging() const
+  {
+    return _priority_aging;
+  }
+
+  void priority_aging(uint32_t priority_aging_)
+  {
+    _priority_aging= priority_aging_;
+  }
+
+  const std::vector<std::pair<std::string, uint32_t> >& max_running() const
+  {
+    return _max_running;
+  }
+
+  void max_running(const char *function_name, uint32_t max_running_)
+  {
+    _max_running.push_back(std::make_pair(std::string(function_name), max_running_));
+  }
+
+  uint32_t retry_backoff() const
+  {
+    return _retry_backoff;
+  }
+
+  uint32_t retry_backoff_max() const
+  {
+    return _retry_backoff_max;
+  }
+
+  void retry_backoff(uint32_t retry_backoff_, uint32_t retry_backoff_max_)
+  {
+    _retry_backoff= retry_backoff_;
+    _retry_backoff_max= retry_backoff_max_;
+  }
+
+  const std::string& dead_letter_function() const
+  {
+    return _dead_letter_function;
+  }
+
+  void dead_letter_function(const char *dead_letter_function_)
+  {
+    _dead_letter_function= dead_letter_function_ ? dead_letter_function_ : "";
+  }
+
 private:
   gearmand_st::SocketOpt _sockopt;
+  bool _background_replay;
+  std::string _spill_file;
+  uint64_t _memory_budget;
+  uint32_t _spill_prefetch;
+  std::string _scheduler;
+  uint32_t _priority_weights[GEARMAN_JOB_PRIORITY_MAX];
+  uint32_t _priority_aging;
+  std::vector<std::pair<std::string, uint32_t> > _max_running;
+  uint32_t _retry_backoff;
+  uint32_t _retry_backoff_max;
+  std::string _dead_letter_function;
 };
 
 } //namespace gearmand
@@ -44,6 +44,7 @@
 #include "gear_config.h"
 
 #include "libgearman-server/common.h"
+#include <libgearman-server/timer_wheel.h>
 
 #include <string.h>
 #include <errno.h>
@@ -128,6 +129,13 @@ static gearman_server_con_st * _server_con_create(gearman_server_thread_st *thre
   con->io_packet_count= 0;
   con->proc_packet_count= 0;
   con->worker_count= 0;
+  con->ready_count= 0;
+  con->capacity= 0;
+  con->job_running= 0;
+  con->grab_command= GEARMAN_COMMAND_UNUSED;
+  con->noreply_accepted= 0;
+  con->noreply_refused= 0;
+  con->job_ttl= 0;
   con->client_count= 0;
   con->thread= thread;
   con->packet= NULL;
@@ -142,11 +150,11 @@ static gearman_server_con_st * _server_con_create(gearman_server_thread_st *thre
   con->to_be_freed_next= NULL;
   con->to_be_freed_prev= NULL;
   con->worker_list= NULL;
+  con->ready_list= NULL;
   con->client_list= NULL;
   con->_host= dcon->host;
   con->_port= dcon->port;
   strcpy(con->id, "-");
-  con->timeout_event= NULL;
 
   con->protocol= NULL;
   con->_ssl= NULL;
@@ -187,7 +195,6 @@ void gearman_server_con_attempt_free(gearman_server_con_st *con)
   {
     if (!(con->proc_removed) and !(Server->proc_shutdown))
     {
-      gearman_server_con_delete_timeout(con);
       con->is_dead= true;
       con->is_sleeping= false;
       con->is_exceptions= Gearmand()->_exceptions;
@@ -217,9 +224,6 @@ void gearman_server_con_free(gearman_server_con_st *con)
   }
 #endif // defined(HAVE_SSL)
 
-
-  gearman_server_con_delete_timeout(con);
-
   if (con->is_cleaned_up)
   {
     gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "con %llu is already cleaned-up. returning", con);
@@ -259,16 +263,6 @@ void gearman_server_con_free(gearman_server_con_st *con)
     gearman_server_client_free(con->client_list);
   }
 
-  if (con->timeout_event != NULL)
-  {
-    if (event_del(con->timeout_event) == -1)
-    {
-      gearmand_log_fatal_perror(GEARMAN_DEFAULT_LOG_PARAM, errno, "calling event_del() on timeout_event failed");
-    }
-    free(con->timeout_event);
-    con->timeout_event= NULL;
-  }
-
   if (con->proc_list)
   {
     gearman_server_con_proc_remove(con);
@@ -379,6 +373,11 @@ void gearman_server_con_free_workers(gearman_server_con_st *con)
   }
 }
 
+bool gearman_server_con_is_full(const gearman_server_con_st *con)
+{
+  return con->capacity and con->job_running >= con->capacity;
+}
+
 void gearman_server_con_to_be_freed_add(gearman_server_con_st *con)
 {
   int lock_error;
@@ -645,27 +644,6 @@ gearman_server_con_proc_next(gearman_server_thread_st *thread)
   return con;
 }
 
-static void _server_job_timeout(int fd, short event, void *arg)
-{
-  (void)fd;
-  (void)event;
-  gearman_server_job_st *job= (gearman_server_job_st *)arg;
-
-  /* A timeout has ocurred on a job, re-queue it */
-  gearmand_log_warning(GEARMAN_DEFAULT_LOG_PARAM,
-                       "Worker timeout reached on job, requeueing: %s %s",
-                       job->job_handle, job->unique);
-
-  gearmand_error_t ret= gearman_server_job_queue(job);
-  if (ret != GEARMAND_SUCCESS)
-  {
-    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM,
-                       "Failed trying to requeue job after timeout, job lost: %s %s",
-                       job->job_handle, job->unique);
-    gearman_server_job_free(job);
-  }
-}
-
 gearmand_error_t gearman_server_con_add_job_timeout(gearman_server_con_st *con, gearman_server_job_st *job)
 {
   if (job)
@@ -687,42 +665,17 @@ gearmand_error_t gearman_server_con_add_job_timeout(gearman_server_con_st *con,
       // We treat 0 and -1 as being the same (i.e. no timer)
       if (worker->timeout > 0)
       {
-        if (worker->timeout < 1000)
-        {
-          worker->timeout= 1000;
-        }
+        // The timeout is in milliseconds, but never shorter than a second.
+        long timeout= std::max(worker->timeout, 1000L);
 
-        gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "Adding timeout on %s for %s (%dl)",
+        gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "Adding timeout on %s for %s (%ld)",
                            job->function->function_name,
                            job->job_handle,
-                           worker->timeout);
-        if (con->timeout_event == NULL)
-        {
-          gearmand_con_st *dcon= con->con.context;
-          con->timeout_event= (struct event *)malloc(sizeof(struct event)); // libevent POD
-          if (con->timeout_event == NULL)
-          {
-            return gearmand_merror("malloc(sizeof(struct event)", struct event, 1);
-          }
-          timeout_set(con->timeout_event, _server_job_timeout, job);
-          if (event_base_set(dcon->thread->base, con->timeout_event) == -1)
-          {
-            gearmand_perror(errno, "event_base_set");
-          }
-        }
+                           timeout);
 
-        /* XXX Right now, if a worker has diff timeouts for functions I think
-          this will overwrite any existing timeouts on that event. One
-          solution to that would be to record the timeout from last time,
-          and only set this one if it is longer than that one. */
-
-        struct timeval timeout_tv = { 0 , 0 };
-        timeout_tv.tv_sec= worker->timeout;
-        timeout_add(con->timeout_event, &timeout_tv);
-      }
-      else if (con->timeout_event) // Delete the timer if it exists
-      {
-        gearman_server_con_delete_timeout(con);
+        /* Each job has its own timeout, so jobs of functions with different
+          timeouts on the same connection do not disturb each other. */
+        con->thread->timer_wheel->add(job, uint64_t(timeout));
       }
     }
   }
@@ -730,16 +683,6 @@ gearmand_error_t gearman_server_con_add_job_timeout(gearman_server_con_st *con,
   return GEARMAND_SUCCESS;
 }
 
-void gearman_server_con_delete_timeout(gearman_server_con_st *con)
-{
-  if (con->timeout_event)
-  {
-    timeout_del(con->timeout_event);
-    free(con->timeout_event);
-    con->timeout_event= NULL;
-  }
-}
-
 gearman_server_con_st *gearmand_ready(gearmand_connection_list_st *universal)
 {
   if (universal->ready_con_list)
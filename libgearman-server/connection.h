@@ -128,6 +128,12 @@ void gearman_server_con_free_worker(gearman_server_con_st *con,
 GEARMAN_API
 void gearman_server_con_free_workers(gearman_server_con_st *con);
 
+/**
+ * True when a worker that declared a capacity already runs that many jobs.
+ */
+GEARMAN_API
+bool gearman_server_con_is_full(const gearman_server_con_st *con);
+
 /**
  * Add connection to the to_be_freed thread list.
  */
@@ -180,18 +186,12 @@ gearman_server_con_st *
 gearman_server_con_proc_next(gearman_server_thread_st *thread);
 
 /**
- * Set protocol context pointer.
- * Add worker timeout for a connection tied to a job
+ * Add the worker timeout of the function of a job that was just assigned to
+ * a connection.
  */
 GEARMAN_API
 gearmand_error_t gearman_server_con_add_job_timeout(gearman_server_con_st *con, gearman_server_job_st *job);
 
-/**
- * Delete timeout event for a server con
- */
-GEARMAN_API
-void gearman_server_con_delete_timeout(gearman_server_con_st *con);
-
 void gearman_server_con_protocol_release(gearman_server_con_st *con);
 
 gearman_server_con_st* build_gearman_server_con_st(void);
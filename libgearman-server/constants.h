@@ -65,6 +65,7 @@
 #define GEARMAND_CONF_MAX_OPTION_SHORT 128
 #define GEARMAND_DEFAULT_BACKLOG 64
 #define GEARMAND_DEFAULT_MAX_QUEUE_SIZE 0
+#define GEARMAND_DEFAULT_RETRY_BACKOFF_MAX 3600
 #define GEARMAND_DEFAULT_SOCKET_RECV_SIZE 32768
 #define GEARMAND_DEFAULT_SOCKET_SEND_SIZE 32768
 #define GEARMAND_DEFAULT_SOCKET_TIMEOUT 10
@@ -76,6 +77,8 @@
 #define GEARMAND_MAX_FREE_SERVER_JOB 1000
 #define GEARMAND_MAX_FREE_SERVER_PACKET 2000
 #define GEARMAND_MAX_FREE_SERVER_WORKER 1000
+#define GEARMAND_MAX_GRAB_JOB_MULTI 256
+#define GEARMAND_MAX_WORKER_CAPACITY 65535
 #define GEARMAND_OPTION_SIZE 64
 #define GEARMAND_PACKET_HEADER_SIZE 12
 #define GEARMAND_PIPE_BUFFER_SIZE 256
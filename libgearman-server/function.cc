@@ -91,7 +91,18 @@ static gearman_server_function_st* gearman_server_function_create(gearman_server
   function->job_count= 0;
   function->job_total= 0;
   function->job_running= 0;
+  function->max_running= 0;
+  function->job_expired= 0;
+  function->retry_backoff= server->retry_backoff;
+  function->retry_backoff_max= server->retry_backoff_max;
   memset(function->max_queue_size, GEARMAND_DEFAULT_MAX_QUEUE_SIZE, sizeof(uint32_t) * GEARMAN_JOB_PRIORITY_MAX);
+  memset(function->job_bytes, 0, sizeof(uint64_t) * GEARMAN_JOB_PRIORITY_MAX);
+  memset(function->max_queue_bytes, 0, sizeof(uint64_t) * GEARMAN_JOB_PRIORITY_MAX);
+  function->memory_size= 0;
+  function->memory_budget= 0;
+  function->weight= 1;
+  memset(function->priority_deficit, 0, sizeof(uint32_t) * GEARMAN_JOB_PRIORITY_MAX);
+  function->priority_cursor= GEARMAN_JOB_PRIORITY_HIGH;
 
   function->function_name= new char[function_name_size +1];
   if (function->function_name == NULL)
@@ -143,4 +154,58 @@ void gearman_server_function_free(gearman_server_st *server, gearman_server_func
   delete [] function->function_name;
   delete function;
 }
+
+uint64_t gearman_server_function_job_bytes(const gearman_server_function_st *function)
+{
+  uint64_t total= 0;
+  for (int priority= 0; priority < GEARMAN_JOB_PRIORITY_MAX; ++priority)
+  {
+    total+= function->job_bytes[priority];
+  }
+
+  return total;
+}
+
+bool gearman_server_function_at_capacity(const gearman_server_function_st *function)
+{
+  return function->max_running and function->job_running >= function->max_running;
+}
+
+void gearman_server_function_wakeup(gearman_server_function_st *function)
+{
+  if (function->worker_list == NULL)
+  {
+    return;
+  }
+
+  gearman_server_worker_st *worker= function->worker_list;
+  uint32_t noop_sent= 0;
+
+  do
+  {
+    if (worker->con->is_sleeping && ! (worker->con->is_noop_sent) &&
+        gearman_server_con_is_full(worker->con) == false)
+    {
+      gearmand_error_t ret= gearman_server_io_packet_add(worker->con, false,
+                                                         GEARMAN_MAGIC_RESPONSE,
+                                                         GEARMAN_COMMAND_NOOP, NULL);
+      if (gearmand_failed(ret))
+      {
+        gearmand_log_gerror_warn(GEARMAN_DEFAULT_LOG_PARAM, ret, "Failed to send NOOP packet to %s:%s", worker->con->host(), worker->con->port());
+      }
+      else
+      {
+        worker->con->is_noop_sent= true;
+        noop_sent++;
+      }
+    }
+
+    worker= worker->function_next;
+  }
+  while (worker != function->worker_list &&
+         (Server->worker_wakeup == 0 ||
+          noop_sent < Server->worker_wakeup));
+
+  function->worker_list= worker;
+}
 #pragma GCC diagnostic pop
@@ -73,6 +73,25 @@ GEARMAN_API
 GEARMAN_API
 void gearman_server_function_free(gearman_server_st *server, gearman_server_function_st *function);
 
+/**
+ * Payload bytes of all jobs of a function, queued or running.
+ */
+GEARMAN_API
+uint64_t gearman_server_function_job_bytes(const gearman_server_function_st *function);
+
+/**
+ * True when the function already runs as many jobs as max_running allows.
+ */
+GEARMAN_API
+bool gearman_server_function_at_capacity(const gearman_server_function_st *function);
+
+/**
+ * Queue a NOOP for the sleeping workers of a function, at most worker_wakeup
+ * of them.
+ */
+GEARMAN_API
+void gearman_server_function_wakeup(gearman_server_function_st *function);
+
 /** @} */
 
 #ifdef __cplusplus
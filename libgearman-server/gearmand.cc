@@ -61,6 +61,7 @@
 #include "libgearman-server/plugins.h"
 #include "libgearman-server/timer.h"
 #include "libgearman-server/queue.h"
+#include "libgearman-server/scheduler.h"
 
 #include "util/memory.h"
 using namespace org::tangent;
@@ -128,15 +129,24 @@ static void gearman_server_free(gearman_server_st& server)
   /* All threads should be cleaned up before calling this. */
   assert(server.thread_list == NULL);
 
+  gearmand_error_t ret= gearman_server_queue_save(server);
+  if (gearmand_failed(ret) and ret != GEARMAND_INVALID_ARGUMENT)
+  {
+    gearmand_gerror("failed to save the queue on shutdown", ret);
+  }
+
   for (uint32_t key= 0; key < server.hashtable_buckets; key++)
   {
     while (server.job_hash[key] != NULL)
     {
-      gearman_server_save_job(server, server.job_hash[key]);
       gearman_server_job_free(server.job_hash[key]);
     }
   }
   gearman_queue_flush(&server);
+  gearman_server_spill_free(server);
+
+  delete server.scheduler;
+  server.scheduler= NULL;
 
   for (uint32_t function_key= 0; function_key < GEARMAND_DEFAULT_HASH_SIZE;
        function_key++)
@@ -175,6 +185,9 @@ static void gearman_server_free(gearman_server_st& server)
     delete worker;
   }
 
+  // Pending replay batches and deferred deletes still need the queue.
+  gearman_server_queue_replay_free(server);
+
   gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "removing queue: %s", (server.queue_version == QUEUE_VERSION_CLASS) ? "CLASS" : "FUNCTION");
   if (server.queue_version == QUEUE_VERSION_CLASS)
   {
@@ -257,9 +270,64 @@ gearmand_st *gearmand_create(gearmand_config_st *config,
     _global_gearmand= NULL;
     return NULL;
   }
+  gearmand->server.flags.background_replay= config->config.background_replay();
 
   gearmand_set_log_fn(gearmand, log_function, log_context, verbose_arg);
 
+  gearmand->server.scheduler= gearmand::Scheduler::create(config->config.scheduler(),
+                                                          config->config.priority_weights(),
+                                                          config->config.priority_aging());
+  if (gearmand->server.scheduler == NULL)
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "Could not create the %s scheduler", config->config.scheduler().c_str());
+    gearmand_free(gearmand);
+    _global_gearmand= NULL;
+    return NULL;
+  }
+  gearmand_log_info(GEARMAN_DEFAULT_LOG_PARAM, "Using the %s scheduler", gearmand->server.scheduler->name());
+
+  gearmand->server.retry_backoff= config->config.retry_backoff();
+  gearmand->server.retry_backoff_max= config->config.retry_backoff_max();
+  if (config->config.dead_letter_function().size() >= sizeof(gearmand->server.dead_letter_function))
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "Dead letter function name is too long");
+    gearmand_free(gearmand);
+    _global_gearmand= NULL;
+    return NULL;
+  }
+  memcpy(gearmand->server.dead_letter_function,
+         config->config.dead_letter_function().c_str(),
+         config->config.dead_letter_function().size());
+  gearmand->server.dead_letter_function_size= config->config.dead_letter_function().size();
+
+  for (std::vector<std::pair<std::string, uint32_t> >::const_iterator iter= config->config.max_running().begin();
+       iter != config->config.max_running().end();
+       ++iter)
+  {
+    gearman_server_function_st *function= gearman_server_function_get(&gearmand->server,
+                                                                      iter->first.c_str(), iter->first.size());
+    if (function == NULL)
+    {
+      gearmand_free(gearmand);
+      _global_gearmand= NULL;
+      return NULL;
+    }
+    function->max_running= iter->second;
+  }
+
+  if (config->config.spill_file().size())
+  {
+    if (gearmand_failed(gearman_server_spill_start(gearmand->server,
+                                                   config->config.spill_file().c_str(),
+                                                   config->config.memory_budget(),
+                                                   config->config.spill_prefetch())))
+    {
+      gearmand_free(gearmand);
+      _global_gearmand= NULL;
+      return NULL;
+    }
+  }
+
   gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "THREADS: %u", threads_arg);
 
   return gearmand;
@@ -271,6 +339,9 @@ void gearmand_free(gearmand_st *gearmand)
   {
     _close_events(gearmand);
 
+    // The replay thread wakes up the other threads, stop it first.
+    gearman_server_queue_replay_stop(gearmand->server);
+
     if (gearmand->threads > 0)
     {
       gearmand_debug("Shutting down all threads");
@@ -388,13 +459,25 @@ gearmand_error_t gearmand_run(gearmand_st *gearmand)
     }
     while (x < gearmand->threads);
 
-    gearmand_debug("replaying queue: begin");
-    gearmand->ret= gearman_server_queue_replay(gearmand->server);
-    if (gearmand_failed(gearmand->ret))
+    if (gearmand->server.flags.background_replay)
+    {
+      gearmand_debug("replaying queue: background");
+      gearmand->ret= gearman_server_queue_replay_start(gearmand->server);
+      if (gearmand_failed(gearmand->ret))
+      {
+        return gearmand_gerror("failed to start queue replay", gearmand->ret);
+      }
+    }
+    else
     {
-      return gearmand_gerror("failed to reload queue", gearmand->ret);
+      gearmand_debug("replaying queue: begin");
+      gearmand->ret= gearman_server_queue_replay(gearmand->server);
+      if (gearmand_failed(gearmand->ret))
+      {
+        return gearmand_gerror("failed to reload queue", gearmand->ret);
+      }
+      gearmand_debug("replaying queue: end");
     }
-    gearmand_debug("replaying queue: end");
   }
 
   gearmand->ret= _watch_events(gearmand);
@@ -1204,17 +1287,23 @@ static bool gearman_server_create(gearman_server_st& server,
   server.state.queue_startup= false;
   server.flags.round_robin= round_robin_arg;
   server.flags.threaded= false;
+  server.flags.background_replay= false;
   server.shutdown= false;
   server.shutdown_graceful= false;
   server.proc_wakeup= false;
   server.proc_shutdown= false;
   server.job_retries= job_retries_arg;
+  server.retry_backoff= 0;
+  server.retry_backoff_max= GEARMAND_DEFAULT_RETRY_BACKOFF_MAX;
+  server.dead_letter_function_size= 0;
   server.worker_wakeup= worker_wakeup_arg;
   server.thread_count= 0;
   server.free_packet_count= 0;
   server.function_count= 0;
   server.job_count= 0;
   server.unique_count= 0;
+  server.deadline_job_count= 0;
+  server.expire_sweep_at= 0;
   server.free_job_count= 0;
   server.free_client_count= 0;
   server.free_worker_count= 0;
@@ -1227,6 +1316,9 @@ static bool gearman_server_create(gearman_server_st& server,
   server.queue_version= QUEUE_VERSION_NONE;
   server.queue.object= NULL;
   server.queue.functions= NULL;
+  server.replay= NULL;
+  server.spill= NULL;
+  server.scheduler= NULL;
 
   server.function_hash= (gearman_server_function_st **) calloc(GEARMAND_DEFAULT_HASH_SIZE, sizeof(gearman_server_function_st *));
   if (server.function_hash == NULL)
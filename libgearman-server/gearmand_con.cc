@@ -45,6 +45,9 @@
 #include "libgearman-server/common.h"
 #include <libgearman-server/gearmand.h>
 #include <libgearman-server/queue.h>
+#include <libgearman-server/scheduler.h>
+#include <libgearman-server/spill.h>
+#include <libgearman-server/timer_wheel.h>
 #include <cstring>
 
 #include <cerrno>
@@ -172,23 +175,6 @@ uint32_t _server_job_hash(const char *key, size_t key_size)
   return (uint32_t)(value == 0 ? 1 : value);
 }
 
-void _server_con_worker_list_append(gearman_server_worker_st *list,
-                                    gearman_server_worker_st *worker)
-{
-  worker->con_prev= NULL;
-  worker->con_next= list;
-  while (worker->con_next != NULL)
-  {
-    worker->con_prev= worker->con_next;
-    worker->con_next= worker->con_next->con_next;
-  }
-
-  if (worker->con_prev)
-  {
-    worker->con_prev->con_next= worker;
-  }
-}
-
 void destroy_gearman_server_job_st(gearman_server_job_st* arg)
 {
   gearmand_debug("delete gearman_server_con_st");
@@ -311,11 +297,17 @@ gearmand_error_t gearman_server_job_cancel(gearman_server_st& server,
 
 gearman_server_job_st * gearman_server_job_peek(gearman_server_con_st *server_con)
 {
+  if (gearman_server_con_is_full(server_con))
+  {
+    return NULL;
+  }
+
   for (gearman_server_worker_st *server_worker= server_con->worker_list;
        server_worker != NULL;
        server_worker= server_worker->con_next)
   {
-    if (server_worker->function->job_count != 0)
+    if (server_worker->function->job_count != 0 and
+        gearman_server_function_at_capacity(server_worker->function) == false)
     {
       for (gearman_job_priority_t priority= GEARMAN_JOB_PRIORITY_HIGH;
            priority != GEARMAN_JOB_PRIORITY_MAX;
@@ -359,82 +351,52 @@ gearman_server_job_st * gearman_server_job_peek(gearman_server_con_st *server_co
 
 gearman_server_job_st *gearman_server_job_take(gearman_server_con_st *server_con)
 {
-  for (gearman_server_worker_st *server_worker= server_con->worker_list; server_worker; server_worker= server_worker->con_next)
+  gearman_server_job_st *server_job= Server->scheduler->take(server_con);
+  if (server_job == NULL)
   {
-    if (server_worker->function and server_worker->function->job_count)
-    {
-      gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "Jobs available for %.*s: %lu",
-                         (int)server_worker->function->function_name_size, server_worker->function->function_name,
-                         (unsigned long)(server_worker->function->job_count));
+    return NULL;
+  }
 
-      if (Server->flags.round_robin)
-      {
-        GEARMAND_LIST_DEL(server_con->worker, server_worker, con_)
-        _server_con_worker_list_append(server_con->worker_list, server_worker);
-        ++server_con->worker_count;
-        if (server_con->worker_list == NULL)
-        {
-          server_con->worker_list= server_worker;
-        }
-      }
+  if (server_job->ignore_job)
+  {
+    gearman_server_job_free(server_job);
+    return gearman_server_job_take(server_con);
+  }
 
-      gearman_job_priority_t priority;
-      for (priority= GEARMAN_JOB_PRIORITY_HIGH; priority < GEARMAN_JOB_PRIORITY_LOW;
-           priority= gearman_job_priority_t(int(priority) +1))
-      {
-        if (server_worker->function->job_list[priority])
-        {
-          break;
-        }
-      }
+  if (gearman_server_job_expired(server_job))
+  {
+    gearman_server_job_expire(server_job);
+    return gearman_server_job_take(server_con);
+  }
 
-      gearman_server_job_st *server_job= server_worker->function->job_list[priority];
-      gearman_server_job_st *previous_job= server_job;
-  
-      int64_t current_time= (int64_t)time(NULL);
-  
-      while (server_job and server_job->when != 0 and server_job->when > current_time)
-      {
-        previous_job= server_job;
-        server_job= server_job->function_next;  
-      }
-  
-      if (server_job)
-      { 
-        if (server_job->function->job_list[priority] == server_job)
-        {
-          // If it's the head of the list, advance it
-          server_job->function->job_list[priority]= server_job->function_next;
-        }
-        else
-        {
-          // Otherwise, just remove the item from the list
-          previous_job->function_next= server_job->function_next;
-        }
-        
-        // If it's the tail of the list, move the tail back
-        if (server_job->function->job_end[priority] == server_job)
-        {
-          server_job->function->job_end[priority]= previous_job;
-        }
-        server_job->function->job_count--;
+  if (Server->spill)
+  {
+    // Dropped jobs are still in the persistent queue, if there is one.
+    gearmand_error_t ret;
+    if (gearmand_failed(ret= Server->spill->load(server_job)))
+    {
+      gearmand_log_gerror(GEARMAN_DEFAULT_LOG_PARAM, ret, "dropping job %s, its payload could not be read back", server_job->job_handle);
+      gearman_server_job_free(server_job);
+      return gearman_server_job_take(server_con);
+    }
 
-        server_job->worker= server_worker;
-        GEARMAND_LIST_ADD(server_worker->job, server_job, worker_);
-        server_job->function->job_running++;
+    Server->spill->prefetch(server_job->function);
+  }
 
-        if (server_job->ignore_job)
-        {
-          gearman_server_job_free(server_job);
-          return gearman_server_job_take(server_con);
-        }
-        
-        return server_job;
-      }
+  return server_job;
+}
+
+static bool _proc_timeouts_pending(gearman_server_st *server)
+{
+  for (gearman_server_thread_st *thread= server->thread_list; thread != NULL; thread= thread->next)
+  {
+    if (thread->timer_wheel and thread->timer_wheel->size())
+    {
+      return true;
     }
   }
-  
-  return NULL;
+
+  return false;
 }
 
 void *_proc(void *data)
@@ -463,7 +425,22 @@ void *_proc(void *data)
         return NULL;
       }
 
-      (void) pthread_cond_wait(&(server->proc_cond), &(server->proc_lock));
+      /* Wake up once a second while jobs with a deadline or a worker
+        timeout may need expiring. */
+      if (server->deadline_job_count or _proc_timeouts_pending(server))
+      {
+        struct timespec wakeup;
+        clock_gettime(CLOCK_REALTIME, &wakeup);
+        wakeup.tv_sec++;
+        if (pthread_cond_timedwait(&(server->proc_cond), &(server->proc_lock), &wakeup) == ETIMEDOUT)
+        {
+          break;
+        }
+      }
+      else
+      {
+        (void) pthread_cond_wait(&(server->proc_cond), &(server->proc_lock));
+      }
     }
     server->proc_wakeup= false;
 
@@ -474,8 +451,14 @@ void *_proc(void *data)
       }
     }
 
+    gearman_server_queue_replay_drain(*server);
+    gearman_server_job_expire_sweep(server);
+
     for (gearman_server_thread_st *thread= server->thread_list; thread != NULL; thread= thread->next)
     {
+      gearman_server_thread_timeouts(thread);
+
+
       gearman_server_con_st *con;
       while ((con= gearman_server_con_proc_next(thread)) != NULL)
       {
@@ -556,8 +539,17 @@ gearman_server_job_st * gearman_server_job_create(gearman_server_st *server)
   server_job->function= NULL;
   server_job->function_next= NULL;
   server_job->data= NULL;
+  server_job->queued_at= 0;
+  server_job->deadline= 0;
+  server_job->spill_id= 0;
+  server_job->spill_offset= 0;
   server_job->client_list= NULL;
   server_job->worker= NULL;
+  server_job->timeout_wheel= NULL;
+  server_job->timeout_slot= NULL;
+  server_job->timeout_next= NULL;
+  server_job->timeout_prev= NULL;
+  server_job->timeout_at= 0;
   server_job->job_handle[0]= 0;
   server_job->unique[0]= 0;
   server_job->unique_length= 0;
@@ -102,6 +102,9 @@ static gearmand_error_t _wakeup_init(gearmand_thread_st *thread);
 static void _wakeup_close(gearmand_thread_st *thread);
 static void _wakeup_clear(gearmand_thread_st *thread);
 static void _wakeup_event(int fd, short events, void *arg);
+static gearmand_error_t _tick_init(gearmand_thread_st *thread);
+static void _tick_clear(gearmand_thread_st *thread);
+static void _tick_event(int fd, short events, void *arg);
 static void _clear_events(gearmand_thread_st *thread);
 
 
@@ -162,6 +165,7 @@ namespace {
 gearmand_thread_st::gearmand_thread_st(gearmand_st& gearmand_):
   is_thread_lock(false),
   is_wakeup_event(false),
+  is_tick_event(false),
   count(0),
   dcon_count(0),
   dcon_add_count(0),
@@ -200,6 +204,7 @@ gearmand_error_t gearmand_thread_create(gearmand_st& gearmand)
 
   thread->is_thread_lock= false;
   thread->is_wakeup_event= false;
+  thread->is_tick_event= false;
   thread->count= 0;
   thread->dcon_count= 0;
   thread->dcon_add_count= 0;
@@ -243,6 +248,12 @@ gearmand_error_t gearmand_thread_create(gearmand_st& gearmand)
   /* If we are not running multi-threaded, just return the thread context. */
   if (gearmand.threads == 0)
   {
+    if (gearmand_failed(ret= _tick_init(thread)))
+    {
+      gearmand_thread_free(thread);
+      return ret;
+    }
+
     return GEARMAND_SUCCESS;
   }
 
@@ -533,6 +544,7 @@ static gearmand_error_t _wakeup_init(gearmand_thread_st *thread)
 static void _wakeup_close(gearmand_thread_st *thread)
 {
   _wakeup_clear(thread);
+  _tick_clear(thread);
 
   if (thread->wakeup_fd[0] >= 0)
   {
@@ -557,6 +569,47 @@ static void _wakeup_clear(gearmand_thread_st *thread)
   }
 }
 
+/*
+  Without a processing thread nothing else runs the timers of the server
+  (job deadlines and worker timeouts) while no connection is active.
+*/
+static gearmand_error_t _tick_init(gearmand_thread_st *thread)
+{
+  event_set(&(thread->tick_event), -1, EV_PERSIST, _tick_event, thread);
+  if (event_base_set(thread->base, &(thread->tick_event)) == -1)
+  {
+    gearmand_perror(errno, "event_base_set");
+  }
+
+  struct timeval tick= { 1, 0 };
+  if (event_add(&(thread->tick_event), &tick) < 0)
+  {
+    gearmand_perror(errno, "event_add");
+    return GEARMAND_EVENT;
+  }
+
+  thread->is_tick_event= true;
+
+  return GEARMAND_SUCCESS;
+}
+
+static void _tick_clear(gearmand_thread_st *thread)
+{
+  if (thread->is_tick_event)
+  {
+    if (event_del(&(thread->tick_event)) < 0)
+    {
+      gearmand_perror(errno, "event_del() failure, shutdown may hang");
+    }
+    thread->is_tick_event= false;
+  }
+}
+
+static void _tick_event(int, short, void *arg)
+{
+  gearmand_thread_run((gearmand_thread_st *)arg);
+}
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunreachable-code"
 static void _wakeup_event(int fd, short events __attribute__ ((unused)), void *arg)
@@ -639,6 +692,7 @@ static void _wakeup_event(int fd, short events __attribute__ ((unused)), void *a
 static void _clear_events(gearmand_thread_st *thread)
 {
   _wakeup_clear(thread);
+  _tick_clear(thread);
 
   while (thread->dcon_list != NULL)
   {
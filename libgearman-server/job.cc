@@ -47,7 +47,14 @@
 #include "libgearman-server/common.h"
 #include <string.h>
 
+#include <algorithm>
+#include <set>
+#include <vector>
+
 #include <libgearman-server/queue.h>
+#include <libgearman-server/spill.h>
+#include <libgearman-server/timer.h>
+#include <libgearman-server/timer_wheel.h>
 
 /*
  * Private declarations
@@ -59,6 +66,123 @@
  * @{
  */
 
+/**
+ * Fail a job for every client waiting on it, remove it from the persistent
+ * queue and free it.
+ */
+static void _server_job_drop(gearman_server_job_st *job)
+{
+  for (gearman_server_client_st* client= job->client_list; client != NULL; client= client->job_next)
+  {
+    gearmand_error_t ret= gearman_server_io_packet_add(client->con, false,
+                                                       GEARMAN_MAGIC_RESPONSE,
+                                                       GEARMAN_COMMAND_WORK_FAIL,
+                                                       job->job_handle,
+                                                       (size_t)strlen(job->job_handle),
+                                                       NULL);
+    if (gearmand_failed(ret))
+    {
+      gearmand_log_gerror_warn(GEARMAN_DEFAULT_LOG_PARAM, ret, "Failed to send WORK_FAIL packet to %s:%s", client->con->host(), client->con->port());
+    }
+  }
+
+  /* Remove from persistent queue if one exists. */
+  if (job->job_queued)
+  {
+    gearmand_error_t ret= gearman_queue_done(Server,
+                                             job->unique, job->unique_length,
+                                             job->function->function_name,
+                                             job->function->function_name_size);
+    if (gearmand_failed(ret))
+    {
+      gearmand_log_gerror_warn(GEARMAN_DEFAULT_LOG_PARAM, ret, "Failed to removed %.*s from persistent queue", int(job->unique_length), job->unique);
+    }
+  }
+
+  gearman_server_job_free(job);
+}
+
+/**
+ * Seconds to wait before the given retry of a job of a function.
+ */
+static uint32_t _server_job_retry_delay(const gearman_server_function_st *function, uint32_t retries)
+{
+  uint64_t delay= function->retry_backoff;
+  for (uint32_t x= 1; x < retries and delay < function->retry_backoff_max; ++x)
+  {
+    delay*= 2;
+  }
+
+  return uint32_t(std::min(delay, uint64_t(function->retry_backoff_max)));
+}
+
+/**
+ * Queue a copy of a job that ran out of retries for the dead letter function,
+ * unless there is none or the job already belongs to it. The workload of the
+ * copy is the function name, unique id and number of runs of the job, each NULL
+ * terminated, followed by the workload of the job. Its unique id is the job
+ * handle of the job.
+ */
+static bool _server_job_dead_letter(gearman_server_job_st *job)
+{
+  if (Server->dead_letter_function_size == 0 or
+      (job->function->function_name_size == Server->dead_letter_function_size and
+       memcmp(job->function->function_name, Server->dead_letter_function, Server->dead_letter_function_size) == 0))
+  {
+    return false;
+  }
+
+  char retries[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+  int retries_length= snprintf(retries, sizeof(retries), "%u", uint32_t(job->retries));
+
+  size_t header_size= job->function->function_name_size +1 +job->unique_length +1 +size_t(retries_length) +1;
+  char *data= static_cast<char *>(malloc(header_size +job->data_size));
+  if (data == NULL)
+  {
+    gearmand_merror("malloc", char, header_size +job->data_size);
+    return false;
+  }
+
+  char *ptr= data;
+  memcpy(ptr, job->function->function_name, job->function->function_name_size);
+  ptr+= job->function->function_name_size;
+  *ptr++= 0;
+  memcpy(ptr, job->unique, job->unique_length);
+  ptr+= job->unique_length;
+  *ptr++= 0;
+  memcpy(ptr, retries, size_t(retries_length) +1);
+  ptr+= retries_length +1;
+
+  if (job->data_size)
+  {
+    if (job->data)
+    {
+      memcpy(ptr, job->data, job->data_size);
+    }
+    else if (Server->spill == NULL or gearmand_failed(Server->spill->read(job, ptr)))
+    {
+      gearmand_log_warning(GEARMAN_DEFAULT_LOG_PARAM, "Could not read the workload of %s for the dead letter function", job->job_handle);
+      free(data);
+      return false;
+    }
+  }
+
+  gearmand_error_t ret;
+  (void)gearman_server_job_add(Server,
+                               Server->dead_letter_function, Server->dead_letter_function_size,
+                               job->job_handle, strlen(job->job_handle),
+                               data, header_size +job->data_size,
+                               job->priority, NULL, &ret, 0);
+  if (ret != GEARMAND_SUCCESS)
+  {
+    gearmand_log_gerror_warn(GEARMAN_DEFAULT_LOG_PARAM, ret, "Could not queue %s for the dead letter function", job->job_handle);
+    free(data);
+    return false;
+  }
+
+  return true;
+}
+
 /**
  * Get a server job structure from the unique ID. If data_size is non-zero,
  * then unique points to the workload data and not a real unique key.
@@ -85,10 +209,17 @@ static gearman_server_job_st * _server_job_get_unique(gearman_server_st *server,
     {
       if (server_job->function == server_function &&
           server_job->unique_key == unique_key &&
-          server_job->data_size == data_size &&
-          memcmp(server_job->data, unique, data_size) == 0)
+          server_job->data_size == data_size)
       {
-        return server_job;
+        if (server_job->spill_id and gearmand_failed(server->spill->load(server_job)))
+        {
+          continue;
+        }
+
+        if (memcmp(server_job->data, unique, data_size) == 0)
+        {
+          return server_job;
+        }
       }
     }
   }
@@ -96,6 +227,140 @@ static gearman_server_job_st * _server_job_get_unique(gearman_server_st *server,
   return NULL;
 }
 
+/**
+ * Find the job for unique in server_function, or create and hash a new one
+ * without storing or queueing it. *ret_ptr is GEARMAND_JOB_EXISTS when the
+ * job was already there.
+ */
+static gearman_server_job_st *_server_job_new(gearman_server_st *server,
+                                              gearman_server_function_st *server_function,
+                                              const char *unique, size_t unique_size,
+                                              const char *reducer_name, size_t reducer_size,
+                                              const void *data, size_t data_size,
+                                              gearman_job_priority_t priority,
+                                              gearmand_error_t *ret_ptr,
+                                              int64_t when)
+{
+  uint32_t key;
+  gearman_server_job_st *server_job;
+  if (unique_size == 0)
+  {
+    server_job= NULL;
+    key= 0;
+  }
+  else
+  {
+    if (unique_size == 1 && *unique ==  '-')
+    {
+      if (data_size == 0)
+      {
+        key= 0;
+        server_job= NULL;
+      }
+      else
+      {
+        /* Look up job via unique data when unique = '-'. */
+        key= _server_job_hash((const char*)data, data_size);
+        server_job= _server_job_get_unique(server, key, server_function, (const char*)data, data_size);
+      }
+    }
+    else
+    {
+      /* Look up job via unique ID first to make sure it's not a duplicate. */
+      key= _server_job_hash(unique, unique_size);
+      server_job= _server_job_get_unique(server, key, server_function, unique, 0);
+    }
+  }
+
+  if (server_job)
+  {
+    *ret_ptr= GEARMAND_JOB_EXISTS;
+    return server_job;
+  }
+
+  gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "Comparing queue %u to limit %u for priority %u",
+                     server_function->job_total, server_function->max_queue_size[priority],
+                     priority);
+  if (server_function->max_queue_size[priority] > 0 &&
+      server_function->job_total >= server_function->max_queue_size[priority])
+  {
+    *ret_ptr= GEARMAND_JOB_QUEUE_FULL;
+    return NULL;
+  }
+
+  if (server_function->max_queue_bytes[priority] > 0 &&
+      gearman_server_function_job_bytes(server_function) +data_size > server_function->max_queue_bytes[priority])
+  {
+    gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "Queue of %.*s is over its byte limit %" PRIu64 " for priority %u",
+                       int(server_function->function_name_size), server_function->function_name,
+                       server_function->max_queue_bytes[priority], priority);
+    *ret_ptr= GEARMAND_JOB_QUEUE_FULL;
+    return NULL;
+  }
+
+  server_job= gearman_server_job_create(server);
+  if (server_job == NULL)
+  {
+    *ret_ptr= GEARMAND_MEMORY_ALLOCATION_FAILURE;
+    return NULL;
+  }
+
+  server_job->priority= priority;
+
+  server_job->function= server_function;
+  server_function->job_total++;
+  server_function->job_bytes[priority]+= data_size;
+
+  int checked_length;
+  checked_length= snprintf(server_job->job_handle, GEARMAND_JOB_HANDLE_SIZE, "%s:%u",
+                           server->job_handle_prefix, server->job_handle_count);
+
+  if (checked_length >= GEARMAND_JOB_HANDLE_SIZE || checked_length < 0)
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "Job handle plus handle count beyond GEARMAND_JOB_HANDLE_SIZE: %s:%u",
+                       server->job_handle_prefix, server->job_handle_count);
+  }
+
+  server_job->unique_length= unique_size;
+  checked_length= snprintf(server_job->unique, GEARMAN_MAX_UNIQUE_SIZE, "%.*s",
+                           (int)unique_size, unique);
+  if (checked_length >= GEARMAN_MAX_UNIQUE_SIZE || checked_length < 0)
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "We received a unique beyond GEARMAN_MAX_UNIQUE_SIZE: %.*s", (int)unique_size, unique);
+  }
+
+  server->job_handle_count++;
+  server_job->data= data;
+  server_job->data_size= data_size;
+  server_job->when= when;
+
+  if (reducer_size)
+  {
+    strncpy(server_job->reducer, reducer_name, reducer_size);
+    server_job->reducer[reducer_size]= 0;
+  }
+  else
+  {
+    server_job->reducer[0]= 0;
+  }
+
+  server_job->unique_key= key;
+  key= key % server->hashtable_buckets;
+  GEARMAND_HASH_ADD(server->unique, key, server_job, unique_);
+
+  key= _server_job_hash(server_job->job_handle,
+                        strlen(server_job->job_handle));
+  server_job->job_handle_key= key;
+  key= key % server->hashtable_buckets;
+  GEARMAND_HASH__ADD(server->job, key, server_job);
+
+  gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "JOB %s :%u",
+                     server_job->job_handle, server_job->job_handle_key);
+
+  *ret_ptr= GEARMAND_SUCCESS;
+  return server_job;
+}
+
 /** @} */
 
 #pragma GCC diagnostic push
@@ -139,107 +404,18 @@ gearman_server_job_add_reducer(gearman_server_st *server,
     return NULL;
   }
 
-  uint32_t key;
-  gearman_server_job_st *server_job;
-  if (unique_size == 0)
-  {
-    server_job= NULL;
-    key= 0;
-  }
-  else
+  gearman_server_job_st *server_job= _server_job_new(server, server_function,
+                                                     unique, unique_size,
+                                                     reducer_name, reducer_size,
+                                                     data, data_size,
+                                                     priority, ret_ptr, when);
+  if (server_job == NULL)
   {
-    if (unique_size == 1 && *unique ==  '-')
-    {
-      if (data_size == 0)
-      {
-        key= 0;
-        server_job= NULL;
-      }
-      else
-      {
-        /* Look up job via unique data when unique = '-'. */
-        key= _server_job_hash((const char*)data, data_size);
-        server_job= _server_job_get_unique(server, key, server_function, (const char*)data, data_size);
-      }
-    }
-    else
-    {
-      /* Look up job via unique ID first to make sure it's not a duplicate. */
-      key= _server_job_hash(unique, unique_size);
-      server_job= _server_job_get_unique(server, key, server_function, unique, 0);
-    }
+    return NULL;
   }
 
-  if (server_job == NULL)
+  if (*ret_ptr == GEARMAND_SUCCESS)
   {
-    gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "Comparing queue %u to limit %u for priority %u",
-                       server_function->job_total, server_function->max_queue_size[priority],
-                       priority);
-    if (server_function->max_queue_size[priority] > 0 &&
-        server_function->job_total >= server_function->max_queue_size[priority])
-    {
-      *ret_ptr= GEARMAND_JOB_QUEUE_FULL;
-      return NULL;
-    }
-
-    server_job= gearman_server_job_create(server);
-    if (server_job == NULL)
-    {
-      *ret_ptr= GEARMAND_MEMORY_ALLOCATION_FAILURE;
-      return NULL;
-    }
-
-    server_job->priority= priority;
-
-    server_job->function= server_function;
-    server_function->job_total++;
-
-    int checked_length;
-    checked_length= snprintf(server_job->job_handle, GEARMAND_JOB_HANDLE_SIZE, "%s:%u",
-                             server->job_handle_prefix, server->job_handle_count);
-
-    if (checked_length >= GEARMAND_JOB_HANDLE_SIZE || checked_length < 0)
-    {
-      gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "Job handle plus handle count beyond GEARMAND_JOB_HANDLE_SIZE: %s:%u",
-                         server->job_handle_prefix, server->job_handle_count);
-    }
-
-    server_job->unique_length= unique_size;
-    checked_length= snprintf(server_job->unique, GEARMAN_MAX_UNIQUE_SIZE, "%.*s",
-                             (int)unique_size, unique);
-    if (checked_length >= GEARMAN_MAX_UNIQUE_SIZE || checked_length < 0)
-    {
-      gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "We received a unique beyond GEARMAN_MAX_UNIQUE_SIZE: %.*s", (int)unique_size, unique);
-    }
-
-    server->job_handle_count++;
-    server_job->data= data;
-    server_job->data_size= data_size;
-		server_job->when= when; 
-
-    if (reducer_size)
-    {
-      strncpy(server_job->reducer, reducer_name, reducer_size);
-      server_job->reducer[reducer_size]= 0;
-    }
-    else
-    {
-      server_job->reducer[0]= 0;
-    }
-		
-    server_job->unique_key= key;
-    key= key % server->hashtable_buckets;
-    GEARMAND_HASH_ADD(server->unique, key, server_job, unique_);
-
-    key= _server_job_hash(server_job->job_handle,
-                          strlen(server_job->job_handle));
-    server_job->job_handle_key= key;
-    key= key % server->hashtable_buckets;
-    GEARMAND_HASH__ADD(server->job, key, server_job);
-
-    gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "JOB %s :%u",
-                       server_job->job_handle, server_job->job_handle_key);
-
     if (server->state.queue_startup)
     {
       server_job->job_queued= true;
@@ -262,6 +438,11 @@ gearman_server_job_add_reducer(gearman_server_st *server,
       server_job->job_queued= true;
     }
 
+    if (server->spill and server_job->data)
+    {
+      server->spill->charge(server_job);
+    }
+
     *ret_ptr= gearman_server_job_queue(server_job);
     if (gearmand_failed(*ret_ptr))
     {
@@ -278,10 +459,6 @@ gearman_server_job_add_reducer(gearman_server_st *server,
       return NULL;
     }
   }
-  else
-  {
-    *ret_ptr= GEARMAND_JOB_EXISTS;
-  }
 
   if (server_client)
   {
@@ -292,16 +469,161 @@ gearman_server_job_add_reducer(gearman_server_st *server,
   return server_job;
 }
 
+void gearman_server_job_add_batch(gearman_server_st *server,
+                                  const gearmand::queue::job_st *jobs, size_t count,
+                                  gearman_server_job_st **server_jobs,
+                                  uint32_t ttl)
+{
+  std::vector<gearmand::queue::job_st> store;
+  std::vector<size_t> added;
+
+  gearman_server_function_st *server_function= NULL;
+  for (size_t x= 0; x < count; ++x)
+  {
+    server_jobs[x]= NULL;
+
+    /* Runs of jobs for the same function share one lookup. */
+    if (server_function == NULL or
+        server_function->function_name_size != jobs[x].function_name_size or
+        memcmp(server_function->function_name, jobs[x].function_name, jobs[x].function_name_size))
+    {
+      server_function= gearman_server_function_get(server, jobs[x].function_name, jobs[x].function_name_size);
+      if (server_function == NULL)
+      {
+        continue;
+      }
+    }
+
+    void *data= NULL;
+    if (jobs[x].data_size)
+    {
+      data= malloc(jobs[x].data_size);
+      if (data == NULL)
+      {
+        gearmand_merror("malloc", char, jobs[x].data_size);
+        continue;
+      }
+      memcpy(data, jobs[x].data, jobs[x].data_size);
+    }
+
+    gearmand_error_t ret;
+    server_jobs[x]= _server_job_new(server, server_function,
+                                    jobs[x].unique, jobs[x].unique_size,
+                                    NULL, 0,
+                                    data, jobs[x].data_size,
+                                    jobs[x].priority, &ret, jobs[x].when);
+    if (ret != GEARMAND_SUCCESS)
+    {
+      free(data);
+      continue;
+    }
+
+    gearmand::queue::job_st job;
+    job.unique= server_jobs[x]->unique;
+    job.unique_size= server_jobs[x]->unique_length;
+    job.function_name= server_function->function_name;
+    job.function_name_size= server_function->function_name_size;
+    job.data= server_jobs[x]->data;
+    job.data_size= server_jobs[x]->data_size;
+    job.priority= server_jobs[x]->priority;
+    job.when= server_jobs[x]->when;
+    store.push_back(job);
+    added.push_back(x);
+  }
+
+  if (added.empty())
+  {
+    return;
+  }
+
+  /* Workers only see the new jobs once all of them are stored. */
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  if (server->state.queue_startup == false)
+  {
+    ret= gearman_queue_add_batch(server, &store[0], store.size());
+    if (gearmand_failed(ret))
+    {
+      gearmand_gerror("gearman_queue_add_batch", ret);
+    }
+  }
+
+  std::set<gearman_server_job_st *> dropped;
+  for (std::vector<size_t>::iterator iter= added.begin(); iter != added.end(); ++iter)
+  {
+    gearman_server_job_st *server_job= server_jobs[*iter];
+    if (gearmand_success(ret))
+    {
+      server_job->job_queued= true;
+      gearman_server_job_set_ttl(server_job, ttl);
+
+      if (server->spill and server_job->data)
+      {
+        server->spill->charge(server_job);
+      }
+
+      if (gearmand_success(gearman_server_job_queue(server_job)))
+      {
+        continue;
+      }
+
+      /* Do our best to remove the job from the queue. */
+      (void)gearman_queue_done(server,
+                               server_job->unique, server_job->unique_length,
+                               server_job->function->function_name,
+                               server_job->function->function_name_size);
+    }
+
+    dropped.insert(server_job);
+    gearman_server_job_free(server_job);
+  }
+
+  /* Duplicates later in the batch point at a dropped job as well. */
+  if (dropped.size())
+  {
+    for (size_t x= 0; x < count; ++x)
+    {
+      if (dropped.count(server_jobs[x]))
+      {
+        server_jobs[x]= NULL;
+      }
+    }
+  }
+}
+
 void gearman_server_job_free(gearman_server_job_st *server_job)
 {
   if (server_job)
   {
     if (server_job->worker != NULL)
     {
+      const bool at_capacity= gearman_server_function_at_capacity(server_job->function);
       server_job->function->job_running--;
+
+      /* Workers put to sleep by max_running may take the next queued job now. */
+      if (at_capacity and server_job->function->job_count)
+      {
+        gearman_server_function_wakeup(server_job->function);
+      }
+    }
+
+    if (server_job->timeout_wheel)
+    {
+      server_job->timeout_wheel->remove(server_job);
     }
 
     server_job->function->job_total--;
+    server_job->function->job_bytes[server_job->priority]-= server_job->data_size;
+
+    if (server_job->deadline)
+    {
+      Server->deadline_job_count--;
+      server_job->deadline= 0;
+    }
+
+    if (Server->spill)
+    {
+      Server->spill->release(server_job);
+    }
 
     if (server_job->data != NULL)
     {
@@ -316,6 +638,7 @@ void gearman_server_job_free(gearman_server_job_st *server_job)
 
     if (server_job->worker != NULL)
     {
+      server_job->worker->con->job_running--;
       GEARMAND_LIST_DEL(server_job->worker->job, server_job, worker_);
     }
 
@@ -337,91 +660,160 @@ void gearman_server_job_free(gearman_server_job_st *server_job)
   }
 }
 
+void gearman_server_job_set_ttl(gearman_server_job_st *server_job, uint32_t ttl)
+{
+  if (ttl == 0)
+  {
+    return;
+  }
+
+  /* Epoch jobs start counting once they are due. */
+  int64_t start= int64_t(libgearman::server::Epoch::current().tv_sec);
+  if (server_job->when > start)
+  {
+    start= server_job->when;
+  }
+
+  if (server_job->deadline == 0)
+  {
+    Server->deadline_job_count++;
+  }
+  server_job->deadline= start +int64_t(ttl);
+}
+
+bool gearman_server_job_expired(const gearman_server_job_st *server_job)
+{
+  return server_job->deadline != 0 and
+    server_job->deadline <= int64_t(libgearman::server::Epoch::current().tv_sec);
+}
+
+void gearman_server_job_expire(gearman_server_job_st *server_job)
+{
+  gearmand_log_notice(GEARMAN_DEFAULT_LOG_PARAM,
+                      "Dropped job past its deadline: %s %.*s",
+                      server_job->job_handle,
+                      (int)server_job->unique_length, server_job->unique);
+
+  server_job->function->job_expired++;
+  _server_job_drop(server_job);
+}
+
+void gearman_server_job_expire_sweep(gearman_server_st *server)
+{
+  if (server->deadline_job_count == 0)
+  {
+    return;
+  }
+
+  /* A deadline is only precise to the second, so one pass a second is enough. */
+  int64_t now= int64_t(libgearman::server::Epoch::current().tv_sec);
+  if (server->expire_sweep_at == now)
+  {
+    return;
+  }
+  server->expire_sweep_at= now;
+
+  for (uint32_t function_key= 0; function_key < GEARMAND_DEFAULT_HASH_SIZE; function_key++)
+  {
+    for (gearman_server_function_st *function= server->function_hash[function_key];
+         function != NULL;
+         function= function->next)
+    {
+      for (uint32_t priority= 0; priority < GEARMAN_JOB_PRIORITY_MAX; priority++)
+      {
+        gearman_server_job_st *previous_job= NULL;
+        gearman_server_job_st *server_job= function->job_list[priority];
+        while (server_job)
+        {
+          gearman_server_job_st *next_job= server_job->function_next;
+          if (gearman_server_job_expired(server_job) == false)
+          {
+            previous_job= server_job;
+            server_job= next_job;
+            continue;
+          }
+
+          if (previous_job == NULL)
+          {
+            function->job_list[priority]= next_job;
+          }
+          else
+          {
+            previous_job->function_next= next_job;
+          }
+
+          if (function->job_end[priority] == server_job)
+          {
+            function->job_end[priority]= previous_job;
+          }
+
+          server_job->function_next= NULL;
+          if (--function->job_count == 0)
+          {
+            gearman_server_worker_idle_function(function);
+          }
+
+          gearman_server_job_expire(server_job);
+          server_job= next_job;
+        }
+      }
+    }
+  }
+}
+
 gearmand_error_t gearman_server_job_queue(gearman_server_job_st *job)
 {
   if (job->worker)
   {
+    if (job->timeout_wheel)
+    {
+      job->timeout_wheel->remove(job);
+    }
+
     job->retries++;
     if (Server->job_retries != 0 && Server->job_retries == job->retries)
     {
-      gearmand_log_notice(GEARMAN_DEFAULT_LOG_PARAM,
-                          "Dropped job due to max retry count: %s %.*s",
-                          job->job_handle,
-                          (int)job->unique_length, job->unique);
-
-      for (gearman_server_client_st* client= job->client_list; client != NULL; client= client->job_next)
+      if (_server_job_dead_letter(job))
       {
-        gearmand_error_t ret= gearman_server_io_packet_add(client->con, false,
-                                                           GEARMAN_MAGIC_RESPONSE,
-                                                           GEARMAN_COMMAND_WORK_FAIL,
-                                                           job->job_handle,
-                                                           (size_t)strlen(job->job_handle),
-                                                           NULL);
-        if (gearmand_failed(ret))
-        {
-          gearmand_log_gerror_warn(GEARMAN_DEFAULT_LOG_PARAM, ret, "Failed to send WORK_FAIL packet to %s:%s", client->con->host(), client->con->port());
-        }
+        gearmand_log_notice(GEARMAN_DEFAULT_LOG_PARAM,
+                            "Moved job to %.*s due to max retry count: %s %.*s",
+                            (int)Server->dead_letter_function_size, Server->dead_letter_function,
+                            job->job_handle,
+                            (int)job->unique_length, job->unique);
       }
-
-      /* Remove from persistent queue if one exists. */
-      if (job->job_queued)
+      else
       {
-        gearmand_error_t ret= gearman_queue_done(Server,
-                                                 job->unique, job->unique_length,
-                                                 job->function->function_name,
-                                                 job->function->function_name_size);
-        if (gearmand_failed(ret))
-        {
-          gearmand_log_gerror_warn(GEARMAN_DEFAULT_LOG_PARAM, ret, "Failed to removed %.*s from persistent queue", int(job->unique_length), job->unique);
-        }
+        gearmand_log_notice(GEARMAN_DEFAULT_LOG_PARAM,
+                            "Dropped job due to max retry count: %s %.*s",
+                            job->job_handle,
+                            (int)job->unique_length, job->unique);
       }
 
-      gearman_server_job_free(job);
+      _server_job_drop(job);
       return GEARMAND_SUCCESS;
     }
 
+    job->worker->con->job_running--;
     GEARMAND_LIST_DEL(job->worker->job, job, worker_);
     job->worker= NULL;
     job->function->job_running--;
     job->function_next= NULL;
     job->numerator= 0;
     job->denominator= 0;
-  }
 
-  /* Queue NOOP for possible sleeping workers. */
-  if (job->function->worker_list != NULL)
-  {
-    gearman_server_worker_st *worker= job->function->worker_list;
-    uint32_t noop_sent= 0;
-
-    do
+    /* A job that just failed is not run again until its backoff is over. */
+    uint32_t delay= _server_job_retry_delay(job->function, job->retries);
+    if (delay)
     {
-      if (worker->con->is_sleeping && ! (worker->con->is_noop_sent))
-      {
-        gearmand_error_t ret= gearman_server_io_packet_add(worker->con, false,
-                                                           GEARMAN_MAGIC_RESPONSE,
-                                                           GEARMAN_COMMAND_NOOP, NULL);
-        if (gearmand_failed(ret))
-        {
-          gearmand_log_gerror_warn(GEARMAN_DEFAULT_LOG_PARAM, ret, "Failed to send NOOP packet to %s:%s", worker->con->host(), worker->con->port());
-        }
-        else
-        {
-          worker->con->is_noop_sent= true;
-          noop_sent++;
-        }
-      }
-
-      worker= worker->function_next;
+      job->when= int64_t(time(NULL)) +int64_t(delay);
     }
-    while (worker != job->function->worker_list &&
-           (Server->worker_wakeup == 0 ||
-            noop_sent < Server->worker_wakeup));
-
-    job->function->worker_list= worker;
   }
 
+  /* Queue NOOP for possible sleeping workers. */
+  gearman_server_function_wakeup(job->function);
+
   /* Queue the job to be run. */
+  job->queued_at= int64_t(libgearman::server::Epoch::current().tv_sec);
   if (job->function->job_list[job->priority] == NULL)
   {
     job->function->job_list[job->priority]= job;
@@ -432,7 +824,15 @@ gearmand_error_t gearman_server_job_queue(gearman_server_job_st *job)
   }
 
   job->function->job_end[job->priority]= job;
-  job->function->job_count++;
+  if (job->function->job_count++ == 0)
+  {
+    gearman_server_worker_ready_function(job->function);
+  }
+
+  if (Server->spill)
+  {
+    Server->spill->queued(job);
+  }
 
   return GEARMAND_SUCCESS;
 }
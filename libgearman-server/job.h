@@ -45,6 +45,10 @@
 
 #include <libgearman-server/struct/job.h>
 
+#ifdef __cplusplus
+namespace gearmand { namespace queue { struct job_st; } }
+#endif
+
 /** @addtogroup gearman_server_job Job Declarations @ingroup gearman_server
  *
  * This is a low level interface for gearman server jobs. This is used
@@ -84,6 +88,18 @@ gearman_server_job_add_reducer(gearman_server_st *server,
                                gearmand_error_t *ret_ptr,
                                int64_t when);
 
+#ifdef __cplusplus
+/**
+ * Add count background jobs with one function lookup per run of jobs for the
+ * same function and one store in the persistent queue for all new jobs.
+ * server_jobs[x] is set to the job for jobs[x], or NULL if it was refused.
+ * New jobs are given ttl seconds to be taken, see gearman_server_job_set_ttl().
+ */
+void gearman_server_job_add_batch(gearman_server_st *server,
+                                  const gearmand::queue::job_st *jobs, size_t count,
+                                  gearman_server_job_st **server_jobs,
+                                  uint32_t ttl);
+#endif
 
 
 /**
@@ -128,13 +144,31 @@ gearman_server_job_take(gearman_server_con_st *server_con);
 GEARMAN_API
 gearmand_error_t gearman_server_job_queue(gearman_server_job_st *server_job);
 
+/**
+ * Give a job ttl seconds to be taken by a worker, counted from when it is due
+ * to run. A ttl of 0 leaves the job without a deadline.
+ */
+void gearman_server_job_set_ttl(gearman_server_job_st *server_job, uint32_t ttl);
+
+/**
+ * See if a job has passed its deadline.
+ */
+bool gearman_server_job_expired(const gearman_server_job_st *server_job);
+
+/**
+ * Drop a job that is no longer queued because it passed its deadline.
+ */
+void gearman_server_job_expire(gearman_server_job_st *server_job);
+
+/**
+ * Drop every queued job that has passed its deadline, at most once a second.
+ */
+void gearman_server_job_expire_sweep(gearman_server_st *server);
+
 uint32_t _server_job_hash(const char *key, size_t key_size);
 
 void *_proc(void *data);
 
-void _server_con_worker_list_append(gearman_server_worker_st *list,
-                                    gearman_server_worker_st *worker);
-
 gearman_server_job_st *gearman_server_job_get_by_unique(gearman_server_st *server,
                                                         const char *unique,
                                                         const size_t unique_length,
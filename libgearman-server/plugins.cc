@@ -49,6 +49,7 @@ namespace plugins {
 void initialize(boost::program_options::options_description &all)
 {
   queue::initialize_default();
+  queue::initialize_snapshot();
 
 #if defined(HAVE_LIBDRIZZLE) && HAVE_LIBDRIZZLE
   if (HAVE_LIBDRIZZLE)
@@ -45,10 +45,14 @@
 #include "libgearman-server/struct/worker.h"
 #include "libgearman-server/struct/function.h"
 #include "libgearman-server/struct/job.h"
+#include "libgearman-server/struct/packet.h"
+#include "libgearman-server/struct/server.h"
 #include "libgearman-server/log.h"
+#include "libgearman-server/spill.h"
 
 #include <algorithm>
 #include <string> 
+#include <vector>
 
 struct gearman_server_con_st;
 struct gearmand_packet_st;
@@ -108,6 +112,72 @@ gearmand_error_t Context::store(gearman_server_st *server,
   return GEARMAND_SUCCESS;
 }
 
+gearmand_error_t Context::store_batch(gearman_server_st *server,
+                                      const job_st *jobs, size_t count,
+                                      batch_complete_fn *complete,
+                                      void *complete_context)
+{
+  if (_store_on_shutdown == false and count)
+  {
+    return add_batch(server, jobs, count, complete, complete_context);
+  }
+
+  if (complete)
+  {
+    complete(GEARMAND_SUCCESS, complete_context);
+  }
+
+  return GEARMAND_SUCCESS;
+}
+
+gearmand_error_t Context::add_batch(gearman_server_st *server,
+                                    const job_st *jobs, size_t count,
+                                    batch_complete_fn *complete,
+                                    void *complete_context)
+{
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  for (size_t x= 0; x < count and gearmand_success(ret); ++x)
+  {
+    ret= add(server,
+             jobs[x].unique, jobs[x].unique_size,
+             jobs[x].function_name, jobs[x].function_name_size,
+             jobs[x].data, jobs[x].data_size,
+             jobs[x].priority,
+             jobs[x].when);
+  }
+
+  if (gearmand_success(ret))
+  {
+    ret= flush(server);
+  }
+
+  if (complete)
+  {
+    complete(ret, complete_context);
+  }
+
+  return ret;
+}
+
+gearmand_error_t Context::done_batch(gearman_server_st *server,
+                                     const job_st *jobs, size_t count)
+{
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  for (size_t x= 0; x < count; ++x)
+  {
+    gearmand_error_t rc= done(server,
+                              jobs[x].unique, jobs[x].unique_size,
+                              jobs[x].function_name, jobs[x].function_name_size);
+    // Keep going, one stale row should not leave the rest behind.
+    if (gearmand_failed(rc))
+    {
+      ret= rc;
+    }
+  }
+
+  return ret;
+}
+
 void Context::save_job(gearman_server_st& server,
                        const gearman_server_job_st* server_job)
 {
@@ -115,17 +185,49 @@ void Context::save_job(gearman_server_st& server,
   {
     if (server_job->job_queued)
     {
+      // Read spilled payloads one at a time rather than loading them all.
+      std::vector<char> spilled;
+      const void *data= server_job->data;
+      if (server_job->spill_id)
+      {
+        spilled.resize(server_job->data_size);
+        if (gearmand_failed(server.spill->read(server_job, &spilled[0])))
+        {
+          return;
+        }
+        data= &spilled[0];
+      }
+
       add(&server,
           server_job->unique, server_job->unique_length,
           server_job->function->function_name,
           server_job->function->function_name_size,
-          server_job->data, server_job->data_size,
+          data, server_job->data_size,
           server_job->priority, 
           server_job->when);
     }
   }
 }
 
+gearmand_error_t Context::save(gearman_server_st& server)
+{
+  if (_store_on_shutdown == false)
+  {
+    return GEARMAND_SUCCESS;
+  }
+
+  for (uint32_t key= 0; key < server.hashtable_buckets; key++)
+  {
+    for (gearman_server_job_st *server_job= server.job_hash[key];
+         server_job != NULL;
+         server_job= server_job->next)
+    {
+      save_job(server, server_job);
+    }
+  }
+
+  return flush(&server);
+}
 
 } // namespace queue
 
@@ -91,6 +91,40 @@ private:
 
 namespace queue {
 
+/*
+  One job as handed to the batch interface. The pointers belong to the
+  caller and stay valid until the call returns, or for store_batch() until
+  the completion callback has run.
+*/
+struct job_st {
+  const char *unique;
+  size_t unique_size;
+  const char *function_name;
+  size_t function_name_size;
+  const void *data;
+  size_t data_size;
+  gearman_job_priority_t priority;
+  int64_t when;
+
+  job_st() :
+    unique(NULL),
+    unique_size(0),
+    function_name(NULL),
+    function_name_size(0),
+    data(NULL),
+    data_size(0),
+    priority(GEARMAN_JOB_PRIORITY_NORMAL),
+    when(0)
+  {
+  }
+};
+
+/*
+  Called exactly once per store_batch() with the result of the whole batch,
+  either before store_batch() returns or later from the server thread.
+*/
+typedef void (batch_complete_fn)(gearmand_error_t ret, void *context);
+
 class Context {
 public:
   Context():
@@ -110,6 +144,11 @@ public:
                          gearman_job_priority_t priority,
                          int64_t when);
 
+  gearmand_error_t store_batch(gearman_server_st *server,
+                               const job_st *jobs, size_t count,
+                               batch_complete_fn *complete= NULL,
+                               void *complete_context= NULL);
+
 protected:
   virtual gearmand_error_t add(gearman_server_st *server,
                                const char *unique,
@@ -120,6 +159,18 @@ protected:
                                size_t data_size,
                                gearman_job_priority_t priority,
                                int64_t when)= 0;
+
+  /*
+    Store count jobs and make them durable. The default calls add() for each
+    job followed by a single flush(), so existing plugins keep working.
+    Plugins with a bulk interface override this; one that completes later
+    returns GEARMAND_SUCCESS once the batch is accepted and reports the real
+    result through complete.
+  */
+  virtual gearmand_error_t add_batch(gearman_server_st *server,
+                                     const job_st *jobs, size_t count,
+                                     batch_complete_fn *complete,
+                                     void *complete_context);
 public:
 
   virtual gearmand_error_t flush(gearman_server_st *server)= 0;
@@ -130,11 +181,22 @@ public:
                                 const char *function_name,
                                 size_t function_name_size)= 0;
 
+  // Only unique and function_name are used. The default calls done() per job.
+  virtual gearmand_error_t done_batch(gearman_server_st *server,
+                                      const job_st *jobs, size_t count);
+
   virtual gearmand_error_t replay(gearman_server_st *server)= 0;
 
   void save_job(gearman_server_st& server,
                 const gearman_server_job_st* server_job);
 
+  /*
+    Save every queued job, on shutdown or for the "snapshot" admin command.
+    Only does something for queues that store on shutdown; the default calls
+    save_job() for each job and then flush().
+  */
+  virtual gearmand_error_t save(gearman_server_st& server);
+
   static gearmand_error_t replay_add(gearman_server_st *server,
                                      void *context,
                                      const char *unique, size_t unique_size,
@@ -142,11 +204,26 @@ public:
                                      const void *data, size_t data_size,
                                      gearman_job_priority_t priority,
                                      int64_t when);
+
+  /*
+    Streaming counterpart of replay_add() for replay() implementations that
+    read jobs in batches. As with replay_add(), the server takes ownership of
+    each job's malloc()ed data; on failure the data of the jobs after the one
+    that failed is freed.
+  */
+  static gearmand_error_t replay_add_batch(gearman_server_st *server,
+                                           const job_st *jobs, size_t count);
+
   void store_on_shutdown(bool store_on_shutdown_)
   {
     _store_on_shutdown= store_on_shutdown_;
   }
 
+  bool store_on_shutdown() const
+  {
+    return _store_on_shutdown;
+  }
+
   bool has_error()
   {
     return _error_string.size();
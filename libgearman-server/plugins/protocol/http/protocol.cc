@@ -149,6 +149,13 @@ public:
     case GEARMAN_COMMAND_JOB_ASSIGN_ALL:
     case GEARMAN_COMMAND_GET_STATUS_UNIQUE:
     case GEARMAN_COMMAND_STATUS_RES_UNIQUE:
+    case GEARMAN_COMMAND_GRAB_JOB_MULTI:
+    case GEARMAN_COMMAND_JOB_ASSIGN_MULTI:
+    case GEARMAN_COMMAND_SUBMIT_JOB_BATCH:
+    case GEARMAN_COMMAND_JOB_CREATED_BATCH:
+    case GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY:
+    case GEARMAN_COMMAND_NOREPLY_ACK_REQ:
+    case GEARMAN_COMMAND_NOREPLY_ACK_RES:
     case GEARMAN_COMMAND_MAX:
       gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,
                          "Bad packet command: gearmand_command_t:%s", 
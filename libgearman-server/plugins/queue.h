@@ -39,6 +39,8 @@
 
 #include <libgearman-server/plugins/queue/default/queue.h>
 
+#include <libgearman-server/plugins/queue/snapshot/queue.h>
+
 #include <libgearman-server/plugins/queue/drizzle/queue.h>
 
 #include <libgearman-server/plugins/queue/libmemcached/queue.h>
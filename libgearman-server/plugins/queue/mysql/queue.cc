@@ -48,12 +48,17 @@
 
 #include <mysql.h>
 #include <errmsg.h>
+#include <algorithm>
 #include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
 
 /**
  * Default values.
  */
 #define GEARMAND_QUEUE_MYSQL_DEFAULT_TABLE "gearman_queue"
+#define GEARMAND_QUEUE_MYSQL_DEFAULT_BATCH_SIZE 1
 
 namespace gearmand { namespace plugins { namespace queue { class MySQL; } } }
 
@@ -71,13 +76,53 @@ public:
   MySQL();
   ~MySQL();
 
+  enum statement_t {
+    ADD_STATEMENT,
+    DONE_STATEMENT
+  };
+
+  /*
+    A job waiting for the next flush. The pointers reference the caller's
+    buffers, which gearman_queue_add() keeps alive until the flush returns.
+  */
+  struct add_row_st {
+    const char *unique;
+    unsigned long unique_size;
+    const char *function_name;
+    unsigned long function_name_size;
+    const void *data;
+    unsigned long data_size;
+    gearman_job_priority_t priority;
+    long long when;
+  };
+
+  /*
+    A completed job waiting to be deleted. Completions outlive the call that
+    reported them, so the keys are copied.
+  */
+  struct done_row_st {
+    std::string unique;
+    std::string function_name;
+  };
+
   gearmand_error_t initialize();
-  gearmand_error_t prepareAddStatement();
-  gearmand_error_t prepareDoneStatement();
+  gearmand_error_t prepareAddStatement(size_t rows);
+  gearmand_error_t prepareDoneStatement(size_t rows);
+  gearmand_error_t execute(statement_t type, size_t rows, MYSQL_BIND *bind);
+  gearmand_error_t flushAdds();
+  gearmand_error_t flushDones();
+
+  size_t batch_size() const
+  {
+    return _batch_size ? _batch_size : 1;
+  }
 
   MYSQL *con;
-  MYSQL_STMT *add_stmt;
-  MYSQL_STMT *done_stmt;
+  // Statements are prepared on demand, one per row count up to batch_size().
+  std::vector<MYSQL_STMT *> add_stmt;
+  std::vector<MYSQL_STMT *> done_stmt;
+  std::vector<add_row_st> pending_add;
+  std::vector<done_row_st> pending_done;
   std::string mysql_host;
   std::string mysql_user;
   std::string mysql_password;
@@ -90,14 +135,15 @@ public:
   }
 
 private:
+  void closeStatement(statement_t type, size_t rows);
+
   in_port_t _port;
+  uint32_t _batch_size;
 };
 
 MySQL::MySQL() :
   Queue("MySQL"),
-  con(NULL),
-  add_stmt(NULL),
-  done_stmt(NULL)
+  con(NULL)
   {
     command_line_options().add_options()
       ("mysql-host", boost::program_options::value(&mysql_host)->default_value("localhost"), "MySQL host.")
@@ -105,15 +151,33 @@ MySQL::MySQL() :
       ("mysql-user", boost::program_options::value(&mysql_user)->default_value(""), "MySQL user.")
       ("mysql-password", boost::program_options::value(&mysql_password)->default_value(""), "MySQL user password.")
       ("mysql-db", boost::program_options::value(&mysql_db)->default_value(""), "MySQL database.")
-      ("mysql-table", boost::program_options::value(&mysql_table)->default_value(GEARMAND_QUEUE_MYSQL_DEFAULT_TABLE), "MySQL table name.");
+      ("mysql-table", boost::program_options::value(&mysql_table)->default_value(GEARMAND_QUEUE_MYSQL_DEFAULT_TABLE), "MySQL table name.")
+      ("mysql-batch-size", boost::program_options::value(&_batch_size)->default_value(GEARMAND_QUEUE_MYSQL_DEFAULT_BATCH_SIZE), "Maximum number of jobs written by a single INSERT or DELETE.");
   }
 
 MySQL::~MySQL()
 {
-  if (add_stmt)
+  if (con and pending_done.size())
   {
-    mysql_stmt_close(add_stmt);
+    (void)flushDones();
+  }
+
+  for (size_t x= 0; x < add_stmt.size(); ++x)
+  {
+    if (add_stmt[x])
+    {
+      mysql_stmt_close(add_stmt[x]);
+    }
   }
+
+  for (size_t x= 0; x < done_stmt.size(); ++x)
+  {
+    if (done_stmt[x])
+    {
+      mysql_stmt_close(done_stmt[x]);
+    }
+  }
+
   if (con)
   {
     mysql_close(con);
@@ -122,25 +186,36 @@ MySQL::~MySQL()
 
 gearmand_error_t MySQL::initialize()
 {
+  add_stmt.assign(batch_size(), NULL);
+  done_stmt.assign(batch_size(), NULL);
+  pending_add.reserve(batch_size());
+  pending_done.reserve(batch_size());
+
   return _initialize(Gearmand()->server, this);
 }
 
-gearmand_error_t MySQL::prepareAddStatement()
+gearmand_error_t MySQL::prepareAddStatement(size_t rows)
 {
-  char query_buffer[1024];
+  assert(rows > 0 and rows <= add_stmt.size());
+  MYSQL_STMT *&stmt= add_stmt[rows -1];
 
-  if ((this->add_stmt= mysql_stmt_init(this->con)) == NULL)
+  if ((stmt= mysql_stmt_init(this->con)) == NULL)
   {
     gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_stmt_init failed: %s", mysql_error(this->con));
     return GEARMAND_QUEUE_ERROR;
   }
 
-  int query_buffer_length= snprintf(query_buffer, sizeof(query_buffer),
-                                    "INSERT INTO %s "
-                                    "(unique_key, function_name, priority, data, when_to_run) "
-                                    "VALUES(?, ?, ?, ?, ?)", this->mysql_table.c_str());
+  std::string query;
+  query.reserve(128 +(rows * 18));
+  query+= "INSERT INTO ";
+  query+= this->mysql_table;
+  query+= " (unique_key, function_name, priority, data, when_to_run) VALUES";
+  for (size_t x= 0; x < rows; ++x)
+  {
+    query+= x ? ",(?, ?, ?, ?, ?)" : "(?, ?, ?, ?, ?)";
+  }
 
-  if (mysql_stmt_prepare(this->add_stmt, query_buffer, query_buffer_length))
+  if (mysql_stmt_prepare(stmt, query.c_str(), query.size()))
   {
     gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_stmt_prepare failed: %s", mysql_error(this->con));
     return GEARMAND_QUEUE_ERROR;
@@ -149,22 +224,36 @@ gearmand_error_t MySQL::prepareAddStatement()
   return GEARMAND_SUCCESS;
 }
 
-gearmand_error_t MySQL::prepareDoneStatement()
+gearmand_error_t MySQL::prepareDoneStatement(size_t rows)
 {
-  char query_buffer[1024];
+  assert(rows > 0 and rows <= done_stmt.size());
+  MYSQL_STMT *&stmt= done_stmt[rows -1];
 
-  if ((this->done_stmt= mysql_stmt_init(this->con)) == NULL)
+  if ((stmt= mysql_stmt_init(this->con)) == NULL)
   {
     gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_stmt_init failed: %s", mysql_error(this->con));
     return GEARMAND_QUEUE_ERROR;
   }
 
-  int query_buffer_length= snprintf(query_buffer, sizeof(query_buffer),
-                                    "DELETE FROM %s "
-                                    "WHERE unique_key=? "
-                                    "AND function_name=?", this->mysql_table.c_str());
+  std::string query;
+  query.reserve(128 +(rows * 8));
+  query+= "DELETE FROM ";
+  query+= this->mysql_table;
+  if (rows == 1)
+  {
+    query+= " WHERE unique_key=? AND function_name=?";
+  }
+  else
+  {
+    query+= " WHERE (unique_key, function_name) IN (";
+    for (size_t x= 0; x < rows; ++x)
+    {
+      query+= x ? ",(?, ?)" : "(?, ?)";
+    }
+    query+= ")";
+  }
 
-  if (mysql_stmt_prepare(this->done_stmt, query_buffer, query_buffer_length))
+  if (mysql_stmt_prepare(stmt, query.c_str(), query.size()))
   {
     gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_stmt_prepare failed: %s", mysql_error(this->con));
     return GEARMAND_QUEUE_ERROR;
@@ -173,6 +262,141 @@ gearmand_error_t MySQL::prepareDoneStatement()
   return GEARMAND_SUCCESS;
 }
 
+void MySQL::closeStatement(statement_t type, size_t rows)
+{
+  MYSQL_STMT *&stmt= (type == ADD_STATEMENT) ? add_stmt[rows -1] : done_stmt[rows -1];
+  if (stmt)
+  {
+    mysql_stmt_close(stmt);
+    stmt= NULL;
+  }
+}
+
+gearmand_error_t MySQL::execute(statement_t type, size_t rows, MYSQL_BIND *bind)
+{
+  while (1)
+  {
+    MYSQL_STMT *&stmt= (type == ADD_STATEMENT) ? add_stmt[rows -1] : done_stmt[rows -1];
+    if (stmt == NULL)
+    {
+      gearmand_error_t ret= (type == ADD_STATEMENT) ? prepareAddStatement(rows) : prepareDoneStatement(rows);
+      if (ret == GEARMAND_QUEUE_ERROR)
+      {
+        closeStatement(type, rows);
+        return GEARMAND_QUEUE_ERROR;
+      }
+    }
+
+    if (mysql_stmt_bind_param(stmt, bind))
+    {
+      if (mysql_stmt_errno(stmt) == CR_NO_PREPARE_STMT)
+      {
+        closeStatement(type, rows);
+        continue;
+      }
+
+      gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_stmt_bind_param failed: %s", mysql_error(this->con));
+      return GEARMAND_QUEUE_ERROR;
+    }
+
+    if (mysql_stmt_execute(stmt))
+    {
+      if (mysql_stmt_errno(stmt) == CR_SERVER_LOST)
+      {
+        closeStatement(type, rows);
+        continue;
+      }
+
+      gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_stmt_execute failed: %s", mysql_error(this->con));
+      return GEARMAND_QUEUE_ERROR;
+    }
+
+    return GEARMAND_SUCCESS;
+  }
+}
+
+gearmand_error_t MySQL::flushAdds()
+{
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  std::vector<MYSQL_BIND> bind;
+
+  for (size_t offset= 0; offset < pending_add.size() and gearmand_success(ret); offset+= batch_size())
+  {
+    size_t rows= std::min(batch_size(), pending_add.size() -offset);
+    bind.assign(rows * 5, MYSQL_BIND());
+
+    for (size_t x= 0; x < rows; ++x)
+    {
+      add_row_st& row= pending_add[offset +x];
+      MYSQL_BIND *row_bind= &bind[x * 5];
+
+      row_bind[0].buffer_type= MYSQL_TYPE_STRING;
+      row_bind[0].buffer= (char *)row.unique;
+      row_bind[0].buffer_length= row.unique_size;
+      row_bind[0].length= &row.unique_size;
+
+      row_bind[1].buffer_type= MYSQL_TYPE_STRING;
+      row_bind[1].buffer= (char *)row.function_name;
+      row_bind[1].buffer_length= row.function_name_size;
+      row_bind[1].length= &row.function_name_size;
+
+      row_bind[2].buffer_type= MYSQL_TYPE_LONG;
+      row_bind[2].buffer= (char *)&row.priority;
+
+      row_bind[3].buffer_type= MYSQL_TYPE_LONG_BLOB;
+      row_bind[3].buffer= (char *)row.data;
+      row_bind[3].buffer_length= row.data_size;
+      row_bind[3].length= &row.data_size;
+
+      row_bind[4].buffer_type= MYSQL_TYPE_LONGLONG;
+      row_bind[4].buffer= (char *)&row.when;
+    }
+
+    ret= execute(ADD_STATEMENT, rows, &bind[0]);
+  }
+
+  pending_add.clear();
+
+  return ret;
+}
+
+gearmand_error_t MySQL::flushDones()
+{
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  std::vector<MYSQL_BIND> bind;
+  std::vector<unsigned long> lengths;
+
+  for (size_t offset= 0; offset < pending_done.size() and gearmand_success(ret); offset+= batch_size())
+  {
+    size_t rows= std::min(batch_size(), pending_done.size() -offset);
+    bind.assign(rows * 2, MYSQL_BIND());
+    lengths.resize(rows * 2);
+
+    for (size_t x= 0; x < rows; ++x)
+    {
+      done_row_st& row= pending_done[offset +x];
+      lengths[x * 2]= row.unique.size();
+      lengths[x * 2 +1]= row.function_name.size();
+
+      bind[x * 2].buffer_type= MYSQL_TYPE_STRING;
+      bind[x * 2].buffer= (char *)row.unique.data();
+      bind[x * 2].buffer_length= lengths[x * 2];
+      bind[x * 2].length= &lengths[x * 2];
+
+      bind[x * 2 +1].buffer_type= MYSQL_TYPE_STRING;
+      bind[x * 2 +1].buffer= (char *)row.function_name.data();
+      bind[x * 2 +1].buffer_length= lengths[x * 2 +1];
+      bind[x * 2 +1].length= &lengths[x * 2 +1];
+    }
+
+    ret= execute(DONE_STATEMENT, rows, &bind[0]);
+  }
+
+  pending_done.clear();
+
+  return ret;
+}
+
 void initialize_mysql()
 {
   static MySQL local_instance;
@@ -264,12 +488,12 @@ gearmand_error_t _initialize(gearman_server_st& server, gearmand::plugins::queue
 
   mysql_free_result(result);
 
-  if (queue->prepareAddStatement() == GEARMAND_QUEUE_ERROR)
+  if (queue->prepareAddStatement(1) == GEARMAND_QUEUE_ERROR)
   {
     return GEARMAND_QUEUE_ERROR;
   }
 
-  if (queue->prepareDoneStatement() == GEARMAND_QUEUE_ERROR)
+  if (queue->prepareDoneStatement(1) == GEARMAND_QUEUE_ERROR)
   {
     return GEARMAND_QUEUE_ERROR;
   }
@@ -290,149 +514,79 @@ static gearmand_error_t _mysql_queue_add(gearman_server_st *, void *context,
         gearman_job_priority_t priority,
         int64_t when)
 {
-  MYSQL_BIND    bind[5];
-
   gearmand::plugins::queue::MySQL *queue= (gearmand::plugins::queue::MySQL *)context;
 
   gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,"MySQL queue add: %.*s %.*s", (uint32_t) unique_size, (char *) unique,
                      (uint32_t) function_name_size, (char *) function_name);
 
-  bind[0].buffer_type= MYSQL_TYPE_STRING;
-  bind[0].buffer= (char *)unique;
-  bind[0].buffer_length= unique_size;
-  bind[0].is_null= 0;
-  bind[0].length= (unsigned long*)&unique_size;
-
-  bind[1].buffer_type= MYSQL_TYPE_STRING;
-  bind[1].buffer= (char *)function_name;
-  bind[1].buffer_length= function_name_size;
-  bind[1].is_null= 0;
-  bind[1].length= (unsigned long*)&function_name_size;
-
-  bind[2].buffer_type= MYSQL_TYPE_LONG;
-  bind[2].buffer= (char *)&priority;
-  bind[2].is_null= 0;
-  bind[2].length= 0;
-
-  bind[3].buffer_type= MYSQL_TYPE_LONG_BLOB;
-  bind[3].buffer= (char *)data;
-  bind[3].buffer_length= data_size;
-  bind[3].is_null= 0;
-  bind[3].length= (unsigned long*)&data_size;
-
-  bind[4].buffer_type= MYSQL_TYPE_LONG;
-  bind[4].buffer= (char *)&when;
-  bind[4].is_null= 0;
-  bind[4].length= 0;
-
-  while(1)
-  {
-    if (mysql_stmt_bind_param(queue->add_stmt, bind))
-    {
-      if ( mysql_stmt_errno(queue->add_stmt) == CR_NO_PREPARE_STMT )
-      {
-        if (queue->prepareAddStatement() == GEARMAND_QUEUE_ERROR)
-        {
-          return GEARMAND_QUEUE_ERROR;
-        }
-        continue;
-      }
-      else
-      {
-        gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_stmt_bind_param failed: %s", mysql_error(queue->con));
-        return GEARMAND_QUEUE_ERROR;
-      }
-    }
-
-    if (mysql_stmt_execute(queue->add_stmt))
-    {
-      if ( mysql_stmt_errno(queue->add_stmt) == CR_SERVER_LOST )
-      {
-        mysql_stmt_close(queue->add_stmt);
-        if (queue->prepareAddStatement() != GEARMAND_QUEUE_ERROR)
-        {
-          continue;
-        }
-      }
-      gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_stmt_execute failed: %s", mysql_error(queue->con));
-      return GEARMAND_QUEUE_ERROR;
-    }
-
-    break;
-  }
+  gearmand::plugins::queue::MySQL::add_row_st row;
+  row.unique= unique;
+  row.unique_size= unique_size;
+  row.function_name= function_name;
+  row.function_name_size= function_name_size;
+  row.data= data;
+  row.data_size= data_size;
+  row.priority= priority;
+  row.when= when;
+  queue->pending_add.push_back(row);
 
   return GEARMAND_SUCCESS;
 }
 
-static gearmand_error_t _mysql_queue_flush(gearman_server_st*, void*)
+/*
+  Pending deletes are written before any inserts so that a job which is
+  resubmitted with the unique of a just completed job does not collide with
+  the stale row.
+*/
+static gearmand_error_t _mysql_queue_flush(gearman_server_st*, void *context)
 {
+  gearmand::plugins::queue::MySQL *queue= (gearmand::plugins::queue::MySQL *)context;
 
-  gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,"MySQL queue flush");
+  gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,"MySQL queue flush: %lu inserts %lu deletes",
+                     (unsigned long)queue->pending_add.size(), (unsigned long)queue->pending_done.size());
 
-  return GEARMAND_SUCCESS;
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  if (queue->pending_done.size())
+  {
+    ret= queue->flushDones();
+  }
+
+  if (queue->pending_add.size())
+  {
+    if (gearmand_failed(ret))
+    {
+      queue->pending_add.clear();
+      return ret;
+    }
+
+    ret= queue->flushAdds();
+  }
+
+  return ret;
 }
 
+/*
+  Completions are coalesced until --mysql-batch-size of them are pending or the
+  queue is next flushed. A crash in between only means the job is replayed.
+*/
 static gearmand_error_t _mysql_queue_done(gearman_server_st*, void *context,
                                           const char *unique,
                                           size_t unique_size,
                                           const char *function_name,
                                           size_t function_name_size)
 {
-
-  MYSQL_BIND    bind[2];
-
   gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,"MySQL queue done: %.*s %.*s", (uint32_t) unique_size, (char *) unique,
                      (uint32_t) function_name_size, (char *) function_name);
 
   gearmand::plugins::queue::MySQL *queue= (gearmand::plugins::queue::MySQL *)context;
 
-  bind[0].buffer_type= MYSQL_TYPE_STRING;
-  bind[0].buffer= (char *)unique;
-  bind[0].buffer_length= unique_size;
-  bind[0].is_null= 0;
-  bind[0].length= (unsigned long*)&unique_size;
-
-  bind[1].buffer_type= MYSQL_TYPE_STRING;
-  bind[1].buffer= (char *)function_name;
-  bind[1].buffer_length= function_name_size;
-  bind[1].is_null= 0;
-  bind[1].length= (unsigned long*)&function_name_size;
+  queue->pending_done.push_back(gearmand::plugins::queue::MySQL::done_row_st());
+  queue->pending_done.back().unique.assign(unique, unique_size);
+  queue->pending_done.back().function_name.assign(function_name, function_name_size);
 
-  while(1)
+  if (queue->pending_done.size() >= queue->batch_size())
   {
-    if (mysql_stmt_bind_param(queue->done_stmt, bind))
-    {
-      if ( mysql_stmt_errno(queue->done_stmt) == CR_NO_PREPARE_STMT )
-      {
-        if (queue->prepareDoneStatement() == GEARMAND_QUEUE_ERROR)
-        {
-          return GEARMAND_QUEUE_ERROR;
-        }
-        continue;
-      }
-      else
-      {
-        gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_stmt_bind_param failed: %s", mysql_error(queue->con));
-        return GEARMAND_QUEUE_ERROR;
-      }
-    }
-
-    if (mysql_stmt_execute(queue->done_stmt))
-    {
-      if ( mysql_stmt_errno(queue->done_stmt) == CR_SERVER_LOST )
-      {
-        mysql_stmt_close(queue->done_stmt);
-        if (queue->prepareDoneStatement() != GEARMAND_QUEUE_ERROR)
-        {
-          continue;
-        }
-      }
-      gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_stmt_execute failed: %s", mysql_error(queue->con));
-
-      return GEARMAND_QUEUE_ERROR;
-    }
-
-    break;
+    return queue->flushDones();
   }
 
   return GEARMAND_SUCCESS;
@@ -461,14 +615,20 @@ static gearmand_error_t _mysql_queue_replay(gearman_server_st* server, void *con
     return GEARMAND_QUEUE_ERROR;
   }
 
-  if (!(result= mysql_store_result(queue->con)))
+  /*
+    Stream the rows rather than buffering the whole table on the client. The
+    connection can not be used for anything else until every row is read,
+    which is fine since jobs added during replay are not written back.
+  */
+  if (!(result= mysql_use_result(queue->con)))
   {
-    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_store_result failed: %s", mysql_error(queue->con));
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_use_result failed: %s", mysql_error(queue->con));
     return GEARMAND_QUEUE_ERROR;
   }
 
   if (mysql_num_fields(result) < 5)
   {
+    mysql_free_result(result);
     gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "MySQL queue: insufficient row fields in queue table");
     return GEARMAND_QUEUE_ERROR;
   }
@@ -488,7 +648,8 @@ static gearmand_error_t _mysql_queue_replay(gearman_server_st* server, void *con
     char * data= (char *)malloc(data_size);
     if (data == NULL)
     {
-      return gearmand_perror(errno, "malloc failed");
+      ret= gearmand_perror(errno, "malloc failed");
+      break;
     }
     memcpy(data, row[2], data_size);
 
@@ -515,6 +676,13 @@ static gearmand_error_t _mysql_queue_replay(gearman_server_st* server, void *con
     }
   }
 
+  if (ret == GEARMAND_SUCCESS and mysql_errno(queue->con))
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "mysql_fetch_row failed: %s", mysql_error(queue->con));
+    ret= GEARMAND_QUEUE_ERROR;
+  }
+
+  /* Drains any rows left behind when the loop ended early. */
   mysql_free_result(result);
 
   return ret;
@@ -55,6 +55,7 @@
 # include <libpq-fe.h>
 #endif
 
+#include <algorithm>
 #include <cerrno>
 
 /**
@@ -67,8 +68,23 @@
  * Default values.
  */
 #define GEARMAND_QUEUE_LIBPQ_DEFAULT_TABLE "queue"
+#define GEARMAND_QUEUE_LIBPQ_DEFAULT_BATCH_SIZE 1
+#define GEARMAND_QUEUE_LIBPQ_REPLAY_FETCH_SIZE "1000"
 #define GEARMAND_QUEUE_QUERY_BUFFER 256
 
+/**
+ * Server side prepared statements.
+ */
+#define GEARMAND_QUEUE_LIBPQ_ADD_STATEMENT "gearmand_queue_add"
+#define GEARMAND_QUEUE_LIBPQ_DONE_STATEMENT "gearmand_queue_done"
+#define GEARMAND_QUEUE_LIBPQ_DONE_BATCH_STATEMENT "gearmand_queue_done_batch"
+
+#if defined(LIBPQ_HAS_PIPELINING) && LIBPQ_HAS_PIPELINING
+# define GEARMAND_QUEUE_LIBPQ_PIPELINE 1
+#else
+# define GEARMAND_QUEUE_LIBPQ_PIPELINE 0
+#endif
+
 namespace gearmand { namespace plugins { namespace  queue { class Postgres; }}}
 
 static gearmand_error_t _initialize(gearman_server_st& server, gearmand::plugins::queue::Postgres *queue);
@@ -99,15 +115,73 @@ public:
     return _create_query;
   }
 
+  const std::string &remove()
+  {
+    return _delete_query;
+  }
+
+  const std::string &remove_batch()
+  {
+    return _delete_batch_query;
+  }
+
+  size_t batch_size() const
+  {
+    return _batch_size ? _batch_size : 1;
+  }
+
+  /*
+    A job waiting for the next flush. The pointers reference the caller's
+    buffers, which gearman_queue_add() keeps alive until the flush returns.
+  */
+  struct add_row_st {
+    const char *unique;
+    size_t unique_size;
+    const char *function_name;
+    size_t function_name_size;
+    const void *data;
+    size_t data_size;
+    char priority[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+    char when[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+  };
+
+  /*
+    A completed job waiting to be deleted. Completions outlive the call that
+    reported them, so the keys are copied.
+  */
+  struct done_row_st {
+    std::string unique;
+    std::string function_name;
+  };
+
+  gearmand_error_t prepare();
+  gearmand_error_t pipeline_begin();
+  gearmand_error_t pipeline_send(const char *statement, int param_count,
+                                 const char * const *param_values,
+                                 const int *param_lengths,
+                                 const int *param_formats);
+  gearmand_error_t pipeline_end();
+  gearmand_error_t flush_dones();
+  gearmand_error_t flush_adds();
+
   PGconn *con;
   std::string postgres_connect_string;
   std::string table;
   std::vector<char> query_buffer;
+  std::vector<add_row_st> pending_add;
+  std::vector<done_row_st> pending_done;
 
 public:
   std::string _insert_query;
   std::string _select_query;
   std::string _create_query;
+  std::string _delete_query;
+  std::string _delete_batch_query;
+
+private:
+  uint32_t _batch_size;
+  size_t _pipeline_sent;
+  bool _pipeline_failed;
 };
 
 Postgres::Postgres() :
@@ -115,17 +189,28 @@ Postgres::Postgres() :
   con(NULL),
   postgres_connect_string(""),
   table(""),
-  query_buffer()
+  query_buffer(),
+  _batch_size(GEARMAND_QUEUE_LIBPQ_DEFAULT_BATCH_SIZE),
+  _pipeline_sent(0),
+  _pipeline_failed(false)
 {
   command_line_options().add_options()
     ("libpq-conninfo", boost::program_options::value(&postgres_connect_string)->default_value(""), "PostgreSQL connection information string.")
-    ("libpq-table", boost::program_options::value(&table)->default_value(GEARMAND_QUEUE_LIBPQ_DEFAULT_TABLE), "Table to use.");
+    ("libpq-table", boost::program_options::value(&table)->default_value(GEARMAND_QUEUE_LIBPQ_DEFAULT_TABLE), "Table to use.")
+    ("libpq-batch-size", boost::program_options::value(&_batch_size)->default_value(GEARMAND_QUEUE_LIBPQ_DEFAULT_BATCH_SIZE), "Maximum number of jobs written per round trip.");
 }
 
 Postgres::~Postgres ()
 {
   if (con)
+  {
+    if (pending_done.size())
+    {
+      (void)flush_dones();
+    }
+
     PQfinish(con);
+  }
 }
 
 gearmand_error_t Postgres::initialize()
@@ -133,12 +218,269 @@ gearmand_error_t Postgres::initialize()
   _create_query+= "CREATE TABLE " +table +" (unique_key VARCHAR" +"(" + TOSTRING(GEARMAN_UNIQUE_SIZE) +"), ";
   _create_query+= "function_name VARCHAR(255), priority INTEGER, data BYTEA, when_to_run INTEGER, UNIQUE (unique_key, function_name))";
 
-  gearmand_error_t ret= _initialize(Gearmand()->server, this);
-
   _insert_query+= "INSERT INTO " +table +" (priority, unique_key, function_name, data, when_to_run) VALUES($1,$2,$3,$4::BYTEA,$5)";
 
   _select_query+= "SELECT unique_key,function_name,priority,data,when_to_run FROM " +table;
 
+  _delete_query+= "DELETE FROM " +table +" WHERE unique_key=$1 AND function_name=$2";
+
+  _delete_batch_query+= "DELETE FROM " +table +" WHERE (unique_key, function_name) IN (SELECT * FROM unnest($1::VARCHAR[], $2::VARCHAR[]))";
+
+  pending_add.reserve(batch_size());
+  pending_done.reserve(batch_size());
+
+  return _initialize(Gearmand()->server, this);
+}
+
+gearmand_error_t Postgres::prepare()
+{
+  const char *names[]= {
+    GEARMAND_QUEUE_LIBPQ_ADD_STATEMENT,
+    GEARMAND_QUEUE_LIBPQ_DONE_STATEMENT,
+    GEARMAND_QUEUE_LIBPQ_DONE_BATCH_STATEMENT };
+
+  const std::string *queries[]= {
+    &_insert_query,
+    &_delete_query,
+    &_delete_batch_query };
+
+  int param_counts[]= { 5, 2, 2 };
+
+  for (size_t x= 0; x < gearmand_array_size(names); ++x)
+  {
+    PGresult *result= PQprepare(con, names[x], queries[x]->c_str(), param_counts[x], NULL);
+    if (result == NULL || PQresultStatus(result) != PGRES_COMMAND_OK)
+    {
+      gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQprepare(%s):%s", names[x], PQerrorMessage(con));
+      PQclear(result);
+      return GEARMAND_QUEUE_ERROR;
+    }
+    PQclear(result);
+  }
+
+  return GEARMAND_SUCCESS;
+}
+
+/*
+  Statements sent between pipeline_begin() and pipeline_end() reach the server
+  in one write and are answered in one read. The server runs them as a single
+  implicit transaction, so a batch is stored either completely or not at all.
+  Without pipeline support in libpq each statement is executed as it is sent.
+*/
+gearmand_error_t Postgres::pipeline_begin()
+{
+  _pipeline_sent= 0;
+  _pipeline_failed= false;
+
+#if GEARMAND_QUEUE_LIBPQ_PIPELINE
+  if (PQenterPipelineMode(con) == 0)
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQenterPipelineMode:%s", PQerrorMessage(con));
+    return GEARMAND_QUEUE_ERROR;
+  }
+#endif
+
+  return GEARMAND_SUCCESS;
+}
+
+gearmand_error_t Postgres::pipeline_send(const char *statement, int param_count,
+                                         const char * const *param_values,
+                                         const int *param_lengths,
+                                         const int *param_formats)
+{
+  if (_pipeline_failed)
+  {
+    return GEARMAND_QUEUE_ERROR;
+  }
+
+#if GEARMAND_QUEUE_LIBPQ_PIPELINE
+  if (PQsendQueryPrepared(con, statement, param_count, param_values, param_lengths, param_formats, 0) == 0)
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQsendQueryPrepared:%s", PQerrorMessage(con));
+    _pipeline_failed= true;
+    return GEARMAND_QUEUE_ERROR;
+  }
+  _pipeline_sent++;
+#else
+  PGresult *result= PQexecPrepared(con, statement, param_count, param_values, param_lengths, param_formats, 0);
+  if (result == NULL || PQresultStatus(result) != PGRES_COMMAND_OK)
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQexecPrepared:%s", PQerrorMessage(con));
+    _pipeline_failed= true;
+  }
+  PQclear(result);
+#endif
+
+  return _pipeline_failed ? GEARMAND_QUEUE_ERROR : GEARMAND_SUCCESS;
+}
+
+gearmand_error_t Postgres::pipeline_end()
+{
+#if GEARMAND_QUEUE_LIBPQ_PIPELINE
+  if (PQpipelineSync(con) == 0)
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQpipelineSync:%s", PQerrorMessage(con));
+    _pipeline_failed= true;
+  }
+  else
+  {
+    for (size_t x= 0; x < _pipeline_sent; ++x)
+    {
+      PGresult *result= PQgetResult(con);
+      if (result == NULL)
+      {
+        gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQgetResult:%s", PQerrorMessage(con));
+        _pipeline_failed= true;
+        break;
+      }
+
+      if (PQresultStatus(result) != PGRES_COMMAND_OK)
+      {
+        // Statements after the one that failed are only reported as aborted.
+        if (PQresultStatus(result) != PGRES_PIPELINE_ABORTED)
+        {
+          gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQgetResult:%s", PQresultErrorMessage(result));
+        }
+        _pipeline_failed= true;
+      }
+      PQclear(result);
+
+      // Each statement's results are terminated by a NULL.
+      while ((result= PQgetResult(con)) != NULL)
+      {
+        PQclear(result);
+      }
+    }
+
+    PGresult *result= PQgetResult(con);
+    if (result == NULL || PQresultStatus(result) != PGRES_PIPELINE_SYNC)
+    {
+      gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQgetResult: expected pipeline sync:%s", PQerrorMessage(con));
+      _pipeline_failed= true;
+    }
+    PQclear(result);
+  }
+
+  if (PQexitPipelineMode(con) == 0)
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQexitPipelineMode:%s", PQerrorMessage(con));
+    _pipeline_failed= true;
+  }
+#endif
+
+  _pipeline_sent= 0;
+
+  return _pipeline_failed ? GEARMAND_QUEUE_ERROR : GEARMAND_SUCCESS;
+}
+
+static void _libpq_array_append(std::string& array, const std::string& value)
+{
+  array+= array.size() > 1 ? ",\"" : "\"";
+  for (std::string::const_iterator iter= value.begin(); iter != value.end(); ++iter)
+  {
+    if (*iter == '"' or *iter == '\\')
+    {
+      array+= '\\';
+    }
+    array+= *iter;
+  }
+  array+= '"';
+}
+
+gearmand_error_t Postgres::flush_dones()
+{
+  gearmand_error_t ret= pipeline_begin();
+  if (gearmand_failed(ret))
+  {
+    pending_done.clear();
+    return ret;
+  }
+
+  std::string uniques;
+  std::string function_names;
+  for (size_t offset= 0; offset < pending_done.size(); offset+= batch_size())
+  {
+    size_t rows= std::min(batch_size(), pending_done.size() -offset);
+
+    if (rows == 1)
+    {
+      const char *param_values[]= {
+        pending_done[offset].unique.c_str(),
+        pending_done[offset].function_name.c_str() };
+
+      (void)pipeline_send(GEARMAND_QUEUE_LIBPQ_DONE_STATEMENT, 2, param_values, NULL, NULL);
+      continue;
+    }
+
+    // Both keys are passed as array literals and matched against unnest().
+    uniques= "{";
+    function_names= "{";
+    for (size_t x= offset; x < offset +rows; ++x)
+    {
+      _libpq_array_append(uniques, pending_done[x].unique);
+      _libpq_array_append(function_names, pending_done[x].function_name);
+    }
+    uniques+= "}";
+    function_names+= "}";
+
+    const char *param_values[]= {
+      uniques.c_str(),
+      function_names.c_str() };
+
+    (void)pipeline_send(GEARMAND_QUEUE_LIBPQ_DONE_BATCH_STATEMENT, 2, param_values, NULL, NULL);
+  }
+
+  pending_done.clear();
+
+  return pipeline_end();
+}
+
+gearmand_error_t Postgres::flush_adds()
+{
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+
+  for (size_t offset= 0; offset < pending_add.size() and gearmand_success(ret); offset+= batch_size())
+  {
+    size_t rows= std::min(batch_size(), pending_add.size() -offset);
+
+    if (gearmand_failed(ret= pipeline_begin()))
+    {
+      break;
+    }
+
+    for (size_t x= offset; x < offset +rows; ++x)
+    {
+      const add_row_st& row= pending_add[x];
+
+      const char *param_values[]= {
+        row.priority,
+        row.unique,
+        row.function_name,
+        (const char *)row.data,
+        row.when };
+
+      int param_lengths[]= {
+        (int)strlen(row.priority),
+        (int)row.unique_size,
+        (int)row.function_name_size,
+        (int)row.data_size,
+        (int)strlen(row.when) };
+
+      int param_formats[] = { 0, 0, 0, 1, 0 };
+
+      if (gearmand_failed(pipeline_send(GEARMAND_QUEUE_LIBPQ_ADD_STATEMENT,
+                                        gearmand_array_size(param_lengths),
+                                        param_values, param_lengths, param_formats)))
+      {
+        break;
+      }
+    }
+
+    ret= pipeline_end();
+  }
+
+  pending_add.clear();
+
   return ret;
 }
 
@@ -234,6 +576,12 @@ gearmand_error_t _initialize(gearman_server_st& server,
 
   PQclear(result);
 
+  if (gearmand_failed(queue->prepare()))
+  {
+    gearman_server_set_queue(server, NULL, NULL, NULL, NULL, NULL);
+    return GEARMAND_QUEUE_ERROR;
+  }
+
   return GEARMAND_SUCCESS;
 }
 
@@ -257,86 +605,125 @@ static gearmand_error_t _libpq_add(gearman_server_st*, void *context,
 {
   gearmand::plugins::queue::Postgres *queue= (gearmand::plugins::queue::Postgres *)context;
 
-  char priority_buffer[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
-  int priority_buffer_length= snprintf(priority_buffer, sizeof(priority_buffer), "%u", static_cast<uint32_t>(priority));
-  char when_buffer[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
-  int when_buffer_length= snprintf(when_buffer, sizeof(when_buffer), "%" PRId64, when);
+  gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "libpq add: %.*s", (uint32_t)unique_size, (char *)unique);
 
-  const char *param_values[]= {
-    (char *)priority_buffer,
-    (char *)unique,
-    (char *)function_name,
-    (char *)data,
-    (char *)when_buffer };
+  queue->pending_add.push_back(gearmand::plugins::queue::Postgres::add_row_st());
+  gearmand::plugins::queue::Postgres::add_row_st& row= queue->pending_add.back();
+  row.unique= unique;
+  row.unique_size= unique_size;
+  row.function_name= function_name;
+  row.function_name_size= function_name_size;
+  row.data= data;
+  row.data_size= data_size;
+  snprintf(row.priority, sizeof(row.priority), "%u", static_cast<uint32_t>(priority));
+  snprintf(row.when, sizeof(row.when), "%" PRId64, when);
 
-  int param_lengths[]= {
-    (int)priority_buffer_length,
-    (int)unique_size,
-    (int)function_name_size,
-    (int)data_size,
-    (int)when_buffer_length };
+  return GEARMAND_SUCCESS;
+}
 
-  int param_formats[] = { 0, 0, 0, 1, 0 };
+/*
+  Pending deletes are written before any inserts so that a job which is
+  resubmitted with the unique of a just completed job does not collide with
+  the stale row.
+*/
+static gearmand_error_t _libpq_flush(gearman_server_st *, void *context)
+{
+  gearmand::plugins::queue::Postgres *queue= (gearmand::plugins::queue::Postgres *)context;
 
-  gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "libpq add: %.*s", (uint32_t)unique_size, (char *)unique);
+  gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "libpq flush: %lu inserts %lu deletes",
+                     (unsigned long)queue->pending_add.size(), (unsigned long)queue->pending_done.size());
 
-  PGresult *result= PQexecParams(queue->con, queue->insert().c_str(),
-                                 gearmand_array_size(param_lengths),
-                                 NULL, param_values, param_lengths, param_formats, 0);
-  if (result == NULL || PQresultStatus(result) != PGRES_COMMAND_OK)
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  if (queue->pending_done.size())
   {
-    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQexec:%s", PQerrorMessage(queue->con));
-    PQclear(result);
-    return GEARMAND_QUEUE_ERROR;
+    ret= queue->flush_dones();
   }
 
-  PQclear(result);
-
-  return GEARMAND_SUCCESS;
-}
+  if (queue->pending_add.size())
+  {
+    if (gearmand_failed(ret))
+    {
+      queue->pending_add.clear();
+      return ret;
+    }
 
-static gearmand_error_t _libpq_flush(gearman_server_st *, void *)
-{
-  gearmand_debug("libpq flush");
+    ret= queue->flush_adds();
+  }
 
-  return GEARMAND_SUCCESS;
+  return ret;
 }
 
+/*
+  Completions are coalesced until --libpq-batch-size of them are pending or the
+  queue is next flushed. A crash in between only means the job is replayed.
+*/
 static gearmand_error_t _libpq_done(gearman_server_st*, void *context,
                                     const char *unique,
                                     size_t unique_size,
                                     const char *function_name,
                                     size_t function_name_size)
 {
-  (void)function_name_size;
   gearmand::plugins::queue::Postgres *queue= (gearmand::plugins::queue::Postgres *)context;
-  PGresult *result;
 
   gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "libpq done: %.*s", (uint32_t)unique_size, (char *)unique);
 
-  std::string query;
-  query.reserve(function_name_size +unique_size + 80);
-  query+= "DELETE FROM ";
-  query+= queue->table;
-  query+= " WHERE unique_key='";
-  query+= (const char *)unique;
-  query+= "' AND function_name='";
-  query+= (const char *)function_name;
-  query+= "'";
-
-  result= PQexec(queue->con, query.c_str());
+  queue->pending_done.push_back(gearmand::plugins::queue::Postgres::done_row_st());
+  queue->pending_done.back().unique.assign(unique, unique_size);
+  queue->pending_done.back().function_name.assign(function_name, function_name_size);
+
+  if (queue->pending_done.size() >= queue->batch_size())
+  {
+    return queue->flush_dones();
+  }
+
+  return GEARMAND_SUCCESS;
+}
+
+/*
+  Replay asks for binary results, so integers arrive in network byte order.
+*/
+static int64_t _libpq_integer(const PGresult *result, int row, int column)
+{
+  if (PQgetisnull(result, row, column))
+  {
+    return 0;
+  }
+
+  const unsigned char *value= (const unsigned char *)PQgetvalue(result, row, column);
+  int length= PQgetlength(result, row, column);
+
+  uint64_t number= 0;
+  for (int x= 0; x < length; ++x)
+  {
+    number= (number << 8) | value[x];
+  }
+
+  if (length == 4)
+  {
+    return int32_t(uint32_t(number));
+  }
+
+  return int64_t(number);
+}
+
+static gearmand_error_t _libpq_command(PGconn *con, const char *command)
+{
+  PGresult *result= PQexec(con, command);
   if (result == NULL || PQresultStatus(result) != PGRES_COMMAND_OK)
   {
-    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQexec:%s", PQerrorMessage(queue->con));
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQexec(%s):%s", command, PQerrorMessage(con));
     PQclear(result);
     return GEARMAND_QUEUE_ERROR;
   }
-
   PQclear(result);
 
   return GEARMAND_SUCCESS;
 }
 
+/*
+  Replay walks the table through a cursor so that only one fetch worth of rows
+  is held on the client at a time.
+*/
 static gearmand_error_t _libpq_replay(gearman_server_st *server, void *context,
                                       gearman_queue_add_fn *add_fn,
                                       void *add_context)
@@ -345,61 +732,86 @@ static gearmand_error_t _libpq_replay(gearman_server_st *server, void *context,
 
   gearmand_info("libpq replay start");
 
-  std::string query("SELECT unique_key,function_name,priority,data,when_to_run FROM " + queue->table);
+  if (gearmand_failed(_libpq_command(queue->con, "BEGIN")))
+  {
+    return GEARMAND_QUEUE_ERROR;
+  }
 
-  PGresult *result= PQexecParams(queue->con, query.c_str(), 0, NULL, NULL, NULL, NULL, 1);
-  if (result == NULL || PQresultStatus(result) != PGRES_TUPLES_OK)
+  std::string declare("DECLARE gearmand_replay NO SCROLL CURSOR FOR " +queue->select());
+  if (gearmand_failed(_libpq_command(queue->con, declare.c_str())))
   {
-    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQexecParams:%s", PQerrorMessage(queue->con));
-    PQclear(result);
+    (void)_libpq_command(queue->con, "ROLLBACK");
     return GEARMAND_QUEUE_ERROR;
   }
 
-  for (int row= 0; row < PQntuples(result); row++)
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  while (gearmand_success(ret))
   {
-    gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,
-                       "libpq replay: %.*s",
-                       PQgetlength(result, row, 0),
-                       PQgetvalue(result, row, 0));
+    PGresult *result= PQexecParams(queue->con, "FETCH FORWARD " GEARMAND_QUEUE_LIBPQ_REPLAY_FETCH_SIZE " FROM gearmand_replay",
+                                   0, NULL, NULL, NULL, NULL, 1);
+    if (result == NULL || PQresultStatus(result) != PGRES_TUPLES_OK)
+    {
+      gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "PQexecParams:%s", PQerrorMessage(queue->con));
+      PQclear(result);
+      ret= GEARMAND_QUEUE_ERROR;
+      break;
+    }
 
-    size_t data_length;
-    char *data;
-    if (PQgetlength(result, row, 3) == 0)
+    if (PQntuples(result) == 0)
     {
-      data= NULL;
-      data_length= 0;
+      PQclear(result);
+      break;
     }
-    else
+
+    for (int row= 0; row < PQntuples(result); row++)
     {
-      data_length= size_t(PQgetlength(result, row, 3));
-      data= (char *)malloc(data_length);
-      if (data == NULL)
+      gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,
+                         "libpq replay: %.*s",
+                         PQgetlength(result, row, 0),
+                         PQgetvalue(result, row, 0));
+
+      size_t data_length;
+      char *data;
+      if (PQgetlength(result, row, 3) == 0)
       {
-        PQclear(result);
-        return gearmand_perror(errno, "malloc");
+        data= NULL;
+        data_length= 0;
+      }
+      else
+      {
+        data_length= size_t(PQgetlength(result, row, 3));
+        data= (char *)malloc(data_length);
+        if (data == NULL)
+        {
+          ret= gearmand_perror(errno, "malloc");
+          break;
+        }
+
+        memcpy(data, PQgetvalue(result, row, 3), data_length);
       }
 
-      memcpy(data, PQgetvalue(result, row, 3), data_length);
+      ret= (*add_fn)(server, add_context, PQgetvalue(result, row, 0),
+                     (size_t)PQgetlength(result, row, 0),
+                     PQgetvalue(result, row, 1),
+                     (size_t)PQgetlength(result, row, 1),
+                     data, data_length,
+                     (gearman_job_priority_t)_libpq_integer(result, row, 2),
+                     _libpq_integer(result, row, 4));
+      if (gearmand_failed(ret))
+      {
+        break;
+      }
     }
 
-    gearmand_error_t ret;
-    ret= (*add_fn)(server, add_context, PQgetvalue(result, row, 0),
-                   (size_t)PQgetlength(result, row, 0),
-                   PQgetvalue(result, row, 1),
-                   (size_t)PQgetlength(result, row, 1),
-                   data, data_length,
-                   (gearman_job_priority_t)atoi(PQgetvalue(result, row, 2)),
-                   atoll(PQgetvalue(result, row, 4)));
-    if (gearmand_failed(ret))
-    {
-      PQclear(result);
-      return ret;
-    }
+    PQclear(result);
   }
 
-  PQclear(result);
+  if (gearmand_failed(_libpq_command(queue->con, gearmand_success(ret) ? "COMMIT" : "ROLLBACK")))
+  {
+    ret= GEARMAND_QUEUE_ERROR;
+  }
 
-  return GEARMAND_SUCCESS;
+  return ret;
 }
 #pragma GCC diagnostic pop
 #pragma GCC diagnostic pop
@@ -0,0 +1,449 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Gearmand client and server library.
+ *
+ *  Copyright (C) 2013 Data Differential, http://datadifferential.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Snapshot Queue Storage Definitions
+ *
+ * Keeps jobs in memory only and writes them to a single file on shutdown or
+ * when the "snapshot" admin command is given. On startup the file is mapped
+ * and replayed, so a restart does not lose queued work without paying for a
+ * write on every job.
+ */
+
+#include <gear_config.h>
+#include <libgearman-server/common.h>
+
+#include <libgearman-server/plugins/queue/snapshot/queue.h>
+#include <libgearman-server/plugins/queue/base.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define GEARMAND_QUEUE_SNAPSHOT_MAGIC "GEARSNAP"
+#define GEARMAND_QUEUE_SNAPSHOT_VERSION 1
+
+namespace gearmand {
+namespace queue {
+
+/*
+  The file is a header followed by count records, each a record header and
+  then the function name, unique and data bytes. Integers are stored in host
+  byte order, a snapshot is only meant to be read back by the same machine.
+*/
+struct snapshot_header_st {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t count;
+};
+
+struct snapshot_record_st {
+  uint32_t function_name_size;
+  uint32_t unique_size;
+  uint64_t data_size;
+  int64_t when;
+  uint32_t priority;
+  uint32_t reserved;
+};
+
+class SnapshotFile : public gearmand::queue::Context
+{
+public:
+  SnapshotFile(const std::string& filename) :
+    _filename(filename),
+    _count(0)
+  {
+  }
+
+  ~SnapshotFile()
+  {
+  }
+
+  gearmand_error_t add(gearman_server_st *server,
+                       const char *unique, size_t unique_size,
+                       const char *function_name, size_t function_name_size,
+                       const void *data, size_t data_size,
+                       gearman_job_priority_t priority,
+                       int64_t when);
+
+  gearmand_error_t flush(gearman_server_st *server);
+
+  gearmand_error_t done(gearman_server_st *server,
+                        const char *unique, size_t unique_size,
+                        const char *function_name, size_t function_name_size);
+
+  gearmand_error_t replay(gearman_server_st *server);
+
+  gearmand_error_t save(gearman_server_st& server);
+
+private:
+  gearmand_error_t write_file();
+
+  std::string _filename;
+  std::vector<char> _records;
+  uint64_t _count;
+};
+
+gearmand_error_t SnapshotFile::add(gearman_server_st*,
+                                   const char *unique, size_t unique_size,
+                                   const char *function_name, size_t function_name_size,
+                                   const void *data, size_t data_size,
+                                   gearman_job_priority_t priority,
+                                   int64_t when)
+{
+  snapshot_record_st record;
+  record.function_name_size= uint32_t(function_name_size);
+  record.unique_size= uint32_t(unique_size);
+  record.data_size= uint64_t(data_size);
+  record.when= when;
+  record.priority= uint32_t(priority);
+  record.reserved= 0;
+
+  const char *ptr= (const char *)&record;
+  _records.insert(_records.end(), ptr, ptr +sizeof(record));
+  _records.insert(_records.end(), function_name, function_name +function_name_size);
+  _records.insert(_records.end(), unique, unique +unique_size);
+  _records.insert(_records.end(), (const char *)data, (const char *)data +data_size);
+  _count++;
+
+  return GEARMAND_SUCCESS;
+}
+
+// Jobs only reach the file through save().
+gearmand_error_t SnapshotFile::flush(gearman_server_st*)
+{
+  return GEARMAND_SUCCESS;
+}
+
+gearmand_error_t SnapshotFile::done(gearman_server_st*,
+                                    const char*, size_t,
+                                    const char*, size_t)
+{
+  return GEARMAND_SUCCESS;
+}
+
+gearmand_error_t SnapshotFile::save(gearman_server_st& server)
+{
+  _records.clear();
+  _count= 0;
+
+  for (uint32_t key= 0; key < server.hashtable_buckets; key++)
+  {
+    for (gearman_server_job_st *server_job= server.job_hash[key];
+         server_job != NULL;
+         server_job= server_job->next)
+    {
+      save_job(server, server_job);
+    }
+  }
+
+  gearmand_error_t ret= write_file();
+
+  gearmand_log_info(GEARMAN_DEFAULT_LOG_PARAM, "snapshot of %llu jobs written to %s: %s",
+                    (unsigned long long)_count, _filename.c_str(), gearmand_strerror(ret));
+
+  std::vector<char>().swap(_records);
+  _count= 0;
+
+  return ret;
+}
+
+/*
+  Write to a temporary file and rename it over the old snapshot once it is on
+  disk, so a crash while saving leaves the previous snapshot intact.
+*/
+gearmand_error_t SnapshotFile::write_file()
+{
+  snapshot_header_st header;
+  memcpy(header.magic, GEARMAND_QUEUE_SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version= GEARMAND_QUEUE_SNAPSHOT_VERSION;
+  header.record_size= uint32_t(sizeof(snapshot_record_st));
+  header.count= _count;
+
+  std::string tmp_filename(_filename);
+  tmp_filename+= ".tmp";
+
+  int fd= open(tmp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd == -1)
+  {
+    return gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, errno, "open(%s)", tmp_filename.c_str());
+  }
+
+  const char *parts[]= { (const char *)&header, _records.empty() ? NULL : &_records[0] };
+  size_t part_sizes[]= { sizeof(header), _records.size() };
+
+  for (size_t x= 0; x < 2; x++)
+  {
+    const char *ptr= parts[x];
+    size_t length= part_sizes[x];
+
+    while (length)
+    {
+      ssize_t written= ::write(fd, ptr, length);
+      if (written == -1)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+
+        int local_errno= errno;
+        close(fd);
+        unlink(tmp_filename.c_str());
+        return gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, local_errno, "write(%s)", tmp_filename.c_str());
+      }
+
+      ptr+= written;
+      length-= size_t(written);
+    }
+  }
+
+  if (fsync(fd) == -1)
+  {
+    int local_errno= errno;
+    close(fd);
+    unlink(tmp_filename.c_str());
+    return gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, local_errno, "fsync(%s)", tmp_filename.c_str());
+  }
+
+  if (close(fd) == -1)
+  {
+    int local_errno= errno;
+    unlink(tmp_filename.c_str());
+    return gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, local_errno, "close(%s)", tmp_filename.c_str());
+  }
+
+  if (rename(tmp_filename.c_str(), _filename.c_str()) == -1)
+  {
+    int local_errno= errno;
+    unlink(tmp_filename.c_str());
+    return gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, local_errno, "rename(%s)", _filename.c_str());
+  }
+
+  return GEARMAND_SUCCESS;
+}
+
+gearmand_error_t SnapshotFile::replay(gearman_server_st *server)
+{
+  int fd= open(_filename.c_str(), O_RDONLY);
+  if (fd == -1)
+  {
+    if (errno == ENOENT)
+    {
+      gearmand_log_info(GEARMAN_DEFAULT_LOG_PARAM, "no snapshot found at %s", _filename.c_str());
+      return GEARMAND_SUCCESS;
+    }
+
+    return gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, errno, "open(%s)", _filename.c_str());
+  }
+
+  struct stat sb;
+  if (fstat(fd, &sb) == -1)
+  {
+    int local_errno= errno;
+    close(fd);
+    return gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, local_errno, "fstat(%s)", _filename.c_str());
+  }
+
+  size_t length= size_t(sb.st_size);
+  if (length < sizeof(snapshot_header_st))
+  {
+    close(fd);
+    return gearmand_log_gerror(GEARMAN_DEFAULT_LOG_PARAM, GEARMAND_QUEUE_ERROR, "%s is too short to be a snapshot", _filename.c_str());
+  }
+
+  void *map= mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  int local_errno= errno;
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    return gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, local_errno, "mmap(%s)", _filename.c_str());
+  }
+  (void)madvise(map, length, MADV_SEQUENTIAL);
+
+  const char *ptr= (const char *)map;
+  const char *end= ptr +length;
+
+  snapshot_header_st header;
+  memcpy(&header, ptr, sizeof(header));
+  ptr+= sizeof(header);
+
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  if (memcmp(header.magic, GEARMAND_QUEUE_SNAPSHOT_MAGIC, sizeof(header.magic)) or
+      header.version != GEARMAND_QUEUE_SNAPSHOT_VERSION or
+      header.record_size != sizeof(snapshot_record_st))
+  {
+    ret= gearmand_log_gerror(GEARMAN_DEFAULT_LOG_PARAM, GEARMAND_QUEUE_ERROR, "%s is not a version %d snapshot", _filename.c_str(), GEARMAND_QUEUE_SNAPSHOT_VERSION);
+  }
+
+  uint64_t replayed= 0;
+  for (; ret == GEARMAND_SUCCESS and replayed < header.count; replayed++)
+  {
+    snapshot_record_st record;
+    if (size_t(end -ptr) < sizeof(record))
+    {
+      ret= GEARMAND_QUEUE_ERROR;
+      break;
+    }
+    memcpy(&record, ptr, sizeof(record));
+    ptr+= sizeof(record);
+
+    if (uint64_t(end -ptr) < uint64_t(record.function_name_size) +record.unique_size +record.data_size)
+    {
+      ret= GEARMAND_QUEUE_ERROR;
+      break;
+    }
+
+    const char *function_name= ptr;
+    ptr+= record.function_name_size;
+    const char *unique= ptr;
+    ptr+= record.unique_size;
+
+    // The server takes ownership of the data.
+    void *data= NULL;
+    if (record.data_size)
+    {
+      data= malloc(size_t(record.data_size));
+      if (data == NULL)
+      {
+        ret= gearmand_merror("malloc", char, size_t(record.data_size));
+        break;
+      }
+      memcpy(data, ptr, size_t(record.data_size));
+      ptr+= record.data_size;
+    }
+
+    ret= replay_add(server, NULL,
+                    unique, record.unique_size,
+                    function_name, record.function_name_size,
+                    data, size_t(record.data_size),
+                    gearman_job_priority_t(record.priority), record.when);
+  }
+
+  munmap(map, length);
+
+  if (ret != GEARMAND_SUCCESS)
+  {
+    return gearmand_log_gerror(GEARMAN_DEFAULT_LOG_PARAM, ret, "%s is truncated or corrupt, replayed %llu of %llu jobs",
+                               _filename.c_str(), (unsigned long long)replayed, (unsigned long long)header.count);
+  }
+
+  /*
+    The jobs now live in memory and will be written out again on shutdown.
+    Keep the loaded file aside rather than replaying it a second time after a
+    crash, when some of its jobs may already have been done.
+  */
+  std::string old_filename(_filename);
+  old_filename+= ".old";
+  if (rename(_filename.c_str(), old_filename.c_str()) == -1)
+  {
+    gearmand_log_perror_warn(GEARMAN_DEFAULT_LOG_PARAM, errno, "rename(%s)", old_filename.c_str());
+  }
+
+  gearmand_log_info(GEARMAN_DEFAULT_LOG_PARAM, "replayed %llu jobs from %s", (unsigned long long)replayed, _filename.c_str());
+
+  return GEARMAND_SUCCESS;
+}
+
+} // namespace queue
+} // namespace gearmand
+
+namespace gearmand {
+namespace plugins {
+namespace queue {
+
+class Snapshot : public gearmand::plugins::Queue
+{
+public:
+  Snapshot();
+  ~Snapshot();
+
+  gearmand_error_t initialize();
+
+  std::string filename;
+};
+
+Snapshot::Snapshot() :
+  Queue("snapshot")
+{
+  command_line_options().add_options()
+    ("snapshot-file", boost::program_options::value(&filename), "File the queue is written to on shutdown and read from on startup.")
+    ;
+}
+
+Snapshot::~Snapshot()
+{
+}
+
+gearmand_error_t Snapshot::initialize()
+{
+  if (filename.empty())
+  {
+    return gearmand_gerror("No --snapshot-file given", GEARMAND_QUEUE_ERROR);
+  }
+
+  gearmand::queue::SnapshotFile* exec_queue= new (std::nothrow) gearmand::queue::SnapshotFile(filename);
+  if (exec_queue == NULL)
+  {
+    return GEARMAND_MEMORY_ALLOCATION_FAILURE;
+  }
+
+  exec_queue->store_on_shutdown(true);
+  gearman_server_set_queue(Gearmand()->server, exec_queue);
+
+  return GEARMAND_SUCCESS;
+}
+
+void initialize_snapshot()
+{
+  static Snapshot local_instance;
+}
+
+} // namespace queue
+} // namespace plugins
+} // namespace gearmand
@@ -432,16 +432,62 @@ gearmand_error_t Instance::done(gearman_server_st*,
                                    const char *function_name,
                                    size_t function_name_size)
 {
-  gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,
-                     "sqlite done: unique_key: %.*s, function_name: %.*s",
-                     int(unique_size), (char*)unique,
-                     int(function_name_size), (char*)function_name);
+  if (_sqlite_lock() == false)
+  {
+    return gearmand_gerror(_error_string.c_str(), GEARMAND_QUEUE_ERROR);
+  }
+
+  gearmand_error_t ret;
+  if (gearmand_failed(ret= _delete(unique, unique_size, function_name, function_name_size)))
+  {
+    return ret;
+  }
 
+  if (_sqlite_commit() == false)
+  {
+    return gearmand_log_gerror(GEARMAN_DEFAULT_LOG_PARAM, GEARMAND_QUEUE_ERROR, "DELETE error: %s", _error_string.c_str());
+  }
+
+  return GEARMAND_SUCCESS;
+}
+
+gearmand_error_t Instance::done_batch(gearman_server_st*,
+                                      const job_st *jobs, size_t count)
+{
   if (_sqlite_lock() == false)
   {
     return gearmand_gerror(_error_string.c_str(), GEARMAND_QUEUE_ERROR);
   }
 
+  // A single transaction for the whole batch.
+  for (size_t x= 0; x < count; ++x)
+  {
+    gearmand_error_t ret;
+    if (gearmand_failed(ret= _delete(jobs[x].unique, jobs[x].unique_size,
+                                     jobs[x].function_name, jobs[x].function_name_size)))
+    {
+      return ret;
+    }
+  }
+
+  if (_sqlite_commit() == false)
+  {
+    return gearmand_log_gerror(GEARMAN_DEFAULT_LOG_PARAM, GEARMAND_QUEUE_ERROR, "DELETE error: %s", _error_string.c_str());
+  }
+
+  return GEARMAND_SUCCESS;
+}
+
+gearmand_error_t Instance::_delete(const char *unique,
+                                   size_t unique_size,
+                                   const char *function_name,
+                                   size_t function_name_size)
+{
+  gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,
+                     "sqlite done: unique_key: %.*s, function_name: %.*s",
+                     int(unique_size), (char*)unique,
+                     int(function_name_size), (char*)function_name);
+
   if (sqlite3_reset(delete_sth) != SQLITE_OK)
   {
     return gearmand_log_gerror(GEARMAN_DEFAULT_LOG_PARAM, GEARMAND_QUEUE_ERROR,
@@ -468,11 +514,6 @@ gearmand_error_t Instance::done(gearman_server_st*,
                                sqlite3_errmsg(_db));
   }
 
-  if (_sqlite_commit() == false)
-  {
-    return gearmand_log_gerror(GEARMAN_DEFAULT_LOG_PARAM, GEARMAND_QUEUE_ERROR, "DELETE error: %s", _error_string.c_str());
-  }
-
   return GEARMAND_SUCCESS;
 }
 
@@ -68,6 +68,9 @@ public:
                         const char *unique, size_t unique_size,
                         const char *function_name, size_t function_name_size);
 
+  gearmand_error_t done_batch(gearman_server_st *server,
+                              const job_st *jobs, size_t count);
+
   gearmand_error_t replay(gearman_server_st *server);
 
   bool has_error()
@@ -77,6 +80,8 @@ public:
 
 private:
   gearmand_error_t replay_loop(gearman_server_st *server);
+  gearmand_error_t _delete(const char *unique, size_t unique_size,
+                           const char *function_name, size_t function_name_size);
 
   void reset_error()
   {
@@ -45,6 +45,12 @@
 #include <tcutil.h>
 #include <tcadb.h>
 
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <pthread.h>
+#include <sys/time.h>
+
 namespace gearmand { namespace plugins { namespace queue { class TokyoCabinet;  }}}
 
 /**
@@ -52,9 +58,12 @@ namespace gearmand { namespace plugins { namespace queue { class TokyoCabinet;
  */
 
 #define GEARMAND_QUEUE_TOKYOCABINET_MAX_KEY_LEN 4096
+#define GEARMAND_QUEUE_TOKYOCABINET_DEFAULT_SYNC "always"
 gearmand_error_t _initialize(gearman_server_st *server,
                              gearmand::plugins::queue::TokyoCabinet *queue);
 
+static void *_libtokyocabinet_sync_thread(void *context);
+
 namespace gearmand {
 namespace plugins {
 namespace queue {
@@ -66,8 +75,44 @@ public:
 
   gearmand_error_t initialize();
 
+  /*
+    always:    tcadbsync() after every stored job (the historical behaviour).
+    <N>ms:     the sync thread calls tcadbsync() every N milliseconds.
+    <N>:       the sync thread calls tcadbsync() once N records were written.
+  */
+  enum sync_policy_t {
+    SYNC_ALWAYS,
+    SYNC_INTERVAL,
+    SYNC_RECORDS
+  };
+
+  bool parse_sync();
+  gearmand_error_t start_sync();
+  void stop_sync();
+
+  // Count a written record, waking up the sync thread when it is due.
+  void written()
+  {
+    if (++unsynced >= sync_value and sync_policy == SYNC_RECORDS)
+    {
+      (void)pthread_cond_signal(&sync_cond);
+    }
+  }
+
+  void lock()
+  {
+    (void)pthread_mutex_lock(&db_lock);
+  }
+
+  void unlock()
+  {
+    (void)pthread_mutex_unlock(&db_lock);
+  }
+
   void destroy()
   {
+    stop_sync();
+
     if (db)
     {
       tcadbdel(db);
@@ -78,21 +123,42 @@ public:
   TCADB *db;
   std::string filename;
   bool optimize;
+  std::string sync;
+  sync_policy_t sync_policy;
+  uint64_t sync_value;
+  uint64_t unsynced;
+  bool sync_shutdown;
+  bool sync_thread_running;
+  pthread_t sync_thread;
+  // Guards db between the server and the sync thread.
+  pthread_mutex_t db_lock;
+  pthread_cond_t sync_cond;
 };
 
 TokyoCabinet::TokyoCabinet() :
   Queue("libtokyocabinet"),
   db(NULL),
-  optimize(false)
+  optimize(false),
+  sync_policy(SYNC_ALWAYS),
+  sync_value(0),
+  unsynced(0),
+  sync_shutdown(false),
+  sync_thread_running(false)
 {
+  (void)pthread_mutex_init(&db_lock, NULL);
+  (void)pthread_cond_init(&sync_cond, NULL);
+
   command_line_options().add_options()
     ("libtokyocabinet-file", boost::program_options::value(&filename), "File name of the database. [see: man tcadb, tcadbopen() for name guidelines]")
-    ("libtokyocabinet-optimize", boost::program_options::bool_switch(&optimize)->default_value(true), "Optimize database on open. [default=true]");
+    ("libtokyocabinet-optimize", boost::program_options::bool_switch(&optimize)->default_value(true), "Optimize database on open. [default=true]")
+    ("libtokyocabinet-sync", boost::program_options::value(&sync)->default_value(GEARMAND_QUEUE_TOKYOCABINET_DEFAULT_SYNC), "When to sync the database to disk: always, every <N>ms, or every <N> records.");
 }
 
 TokyoCabinet::~TokyoCabinet()
 {
   destroy();
+  (void)pthread_cond_destroy(&sync_cond);
+  (void)pthread_mutex_destroy(&db_lock);
 }
 
 gearmand_error_t TokyoCabinet::initialize()
@@ -100,6 +166,72 @@ gearmand_error_t TokyoCabinet::initialize()
   return _initialize(&Gearmand()->server, this);
 }
 
+bool TokyoCabinet::parse_sync()
+{
+  if (sync.compare("always") == 0)
+  {
+    sync_policy= SYNC_ALWAYS;
+    sync_value= 0;
+    return true;
+  }
+
+  char *end;
+  errno= 0;
+  unsigned long long value= strtoull(sync.c_str(), &end, 10);
+  if (errno or end == sync.c_str() or value == 0)
+  {
+    return false;
+  }
+
+  if (*end == 0)
+  {
+    sync_policy= SYNC_RECORDS;
+  }
+  else if (strcmp(end, "ms") == 0)
+  {
+    sync_policy= SYNC_INTERVAL;
+  }
+  else
+  {
+    return false;
+  }
+  sync_value= value;
+
+  return true;
+}
+
+gearmand_error_t TokyoCabinet::start_sync()
+{
+  if (sync_policy == SYNC_ALWAYS)
+  {
+    return GEARMAND_SUCCESS;
+  }
+
+  sync_shutdown= false;
+  int pthread_error;
+  if ((pthread_error= pthread_create(&sync_thread, NULL, _libtokyocabinet_sync_thread, this)))
+  {
+    return gearmand_perror(pthread_error, "pthread_create");
+  }
+  sync_thread_running= true;
+
+  return GEARMAND_SUCCESS;
+}
+
+void TokyoCabinet::stop_sync()
+{
+  if (sync_thread_running)
+  {
+    lock();
+    sync_shutdown= true;
+    (void)pthread_cond_signal(&sync_cond);
+    unlock();
+
+    (void)pthread_join(sync_thread, NULL);
+    sync_thread_running= false;
+  }
+}
+
 void initialize_tokyocabinet()
 {
   static TokyoCabinet local_instance;
@@ -185,6 +317,12 @@ gearmand_error_t _initialize(gearman_server_st *server,
     return GEARMAND_QUEUE_ERROR;
   }
 
+  if (queue->parse_sync() == false)
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "Invalid --libtokyocabinet-sync value: %s", queue->sync.c_str());
+    return GEARMAND_QUEUE_ERROR;
+  }
+
   if (tcadbopen(queue->db, queue->filename.c_str()) == 0)
   {
     gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, 
@@ -205,11 +343,72 @@ gearmand_error_t _initialize(gearman_server_st *server,
     }
   }
 
+  gearmand_error_t ret;
+  if (gearmand_failed(ret= queue->start_sync()))
+  {
+    queue->destroy();
+    return ret;
+  }
+
   gearman_server_set_queue(*server, queue, _libtokyocabinet_add, _libtokyocabinet_flush, _libtokyocabinet_done, _libtokyocabinet_replay);   
    
   return GEARMAND_SUCCESS;
 }
 
+/*
+  Sync thread, only started for the interval and record count policies. It
+  holds the database lock while syncing, so writers wait for at most one
+  tcadbsync() instead of paying for one per job.
+*/
+static void *_libtokyocabinet_sync_thread(void *context)
+{
+  gearmand::plugins::queue::TokyoCabinet *queue= (gearmand::plugins::queue::TokyoCabinet *)context;
+
+  (void)gearmand_initialize_thread_logging("[ tcsync ]");
+
+  queue->lock();
+  while (queue->sync_shutdown == false)
+  {
+    if (queue->sync_policy == gearmand::plugins::queue::TokyoCabinet::SYNC_INTERVAL)
+    {
+      struct timeval now;
+      gettimeofday(&now, NULL);
+
+      uint64_t nsec= uint64_t(now.tv_usec) * 1000 +(queue->sync_value % 1000) * 1000000;
+      struct timespec deadline;
+      deadline.tv_sec= now.tv_sec +time_t(queue->sync_value / 1000) +time_t(nsec / 1000000000);
+      deadline.tv_nsec= long(nsec % 1000000000);
+
+      while (queue->sync_shutdown == false)
+      {
+        if (pthread_cond_timedwait(&queue->sync_cond, &queue->db_lock, &deadline) == ETIMEDOUT)
+        {
+          break;
+        }
+      }
+    }
+    else
+    {
+      while (queue->sync_shutdown == false and queue->unsynced < queue->sync_value)
+      {
+        (void)pthread_cond_wait(&queue->sync_cond, &queue->db_lock);
+      }
+    }
+
+    if (queue->unsynced and queue->db)
+    {
+      queue->unsynced= 0;
+      if (tcadbsync(queue->db) == 0)
+      {
+        gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM, "tcadbsync: %s", _libtokyocabinet_tcaerrmsg(queue->db));
+      }
+    }
+  }
+  queue->unlock();
+
+  return NULL;
+}
+
 /*
  * Private definitions
  */
@@ -277,11 +476,14 @@ static gearmand_error_t _libtokyocabinet_add(gearman_server_st*, void *context,
       // add the rest...
       tcxstrcat(job_data, (const char *)data, (int)data_size);
 
+      queue->lock();
       if (tcadbput(queue->db, tcxstrptr(key), tcxstrsize(key),
                    tcxstrptr(job_data), tcxstrsize(job_data)))
       {
+        queue->written();
         ret= GEARMAND_SUCCESS;
       }
+      queue->unlock();
 
       tcxstrdel(job_data);
     }
@@ -298,7 +500,18 @@ static gearmand_error_t _libtokyocabinet_flush(gearman_server_st *, void *contex
    
   gearmand_debug("libtokyocabinet flush");
 
-  if (tcadbsync(queue->db) == 0)
+  // The sync thread takes care of the other policies.
+  if (queue->sync_policy != gearmand::plugins::queue::TokyoCabinet::SYNC_ALWAYS)
+  {
+    return GEARMAND_SUCCESS;
+  }
+
+  queue->lock();
+  queue->unsynced= 0;
+  bool rc= tcadbsync(queue->db);
+  queue->unlock();
+
+  if (rc == false)
   {
     return GEARMAND_QUEUE_ERROR;
   }
@@ -324,7 +537,13 @@ static gearmand_error_t _libtokyocabinet_done(gearman_server_st *, void *context
 
   TCXSTR* key= tcxstrnew();
   tcxstrcat(key, key_str, (int)key_length);
+  queue->lock();
   bool rc= tcadbout(queue->db, tcxstrptr(key), tcxstrsize(key));
+  if (rc)
+  {
+    queue->written();
+  }
+  queue->unlock();
   tcxstrdel(key);
 
   if (rc)
@@ -405,6 +624,58 @@ static gearmand_error_t _callback_for_record(gearman_server_st *server,
 }
 
 
+/*
+  Walk the records with the native cursor of the underlying database, which
+  hands back key and value together. Other database types fall back to the
+  abstract iterator plus a lookup per key.
+*/
+static bool _libtokyocabinet_next(TCADB *db, void *cursor, TCXSTR *key, TCXSTR *data)
+{
+  tcxstrclear(key);
+  tcxstrclear(data);
+
+  switch (tcadbomode(db))
+  {
+  case ADBOHDB:
+    return tchdbiternext3((TCHDB *)tcadbreveal(db), key, data);
+
+  case ADBOBDB:
+    {
+      BDBCUR *bdb_cursor= (BDBCUR *)cursor;
+      if (tcbdbcurrec(bdb_cursor, key, data) == false)
+      {
+        return false;
+      }
+      (void)tcbdbcurnext(bdb_cursor);
+    }
+    return true;
+
+  default:
+    break;
+  }
+
+  int iter_size= 0;
+  void *iter;
+  while ((iter= tcadbiternext(db, &iter_size)))
+  {
+    tcxstrcat(key, iter, iter_size);
+    free(iter);
+
+    iter= tcadbget(db, tcxstrptr(key), tcxstrsize(key), &iter_size);
+    if (iter)
+    {
+      tcxstrcat(data, iter, iter_size);
+      free(iter);
+      return true;
+    }
+
+    gearmand_log_info(GEARMAN_DEFAULT_LOG_PARAM, "libtokyocabinet replay key disappeared: %s", (char *)tcxstrptr(key));
+    tcxstrclear(key);
+  }
+
+  return false;
+}
+
 static gearmand_error_t _libtokyocabinet_replay(gearman_server_st *server, void *context,
                                                 gearman_queue_add_fn *add_fn,
                                                 void *add_context)
@@ -412,33 +683,43 @@ static gearmand_error_t _libtokyocabinet_replay(gearman_server_st *server, void
   gearmand::plugins::queue::TokyoCabinet *queue= (gearmand::plugins::queue::TokyoCabinet *)context;
    
   gearmand_info("libtokyocabinet replay start");
-  
-  if (tcadbiterinit(queue->db) == 0)
+
+  queue->lock();
+
+  void *cursor= NULL;
+  bool started;
+  switch (tcadbomode(queue->db))
+  {
+  case ADBOHDB:
+    started= tchdbiterinit((TCHDB *)tcadbreveal(queue->db));
+    break;
+
+  case ADBOBDB:
+    if ((cursor= tcbdbcurnew((TCBDB *)tcadbreveal(queue->db))))
+    {
+      // An empty database has no first record, which is not an error.
+      (void)tcbdbcurfirst((BDBCUR *)cursor);
+    }
+    started= bool(cursor);
+    break;
+
+  default:
+    started= tcadbiterinit(queue->db);
+    break;
+  }
+
+  if (started == false)
   {
+    queue->unlock();
     return GEARMAND_QUEUE_ERROR;
   }
 
   TCXSTR* key= tcxstrnew();
   TCXSTR* data= tcxstrnew();
   gearmand_error_t gret= GEARMAND_SUCCESS;
-  void *iter= NULL;
   uint64_t x= 0;
-  int iter_size= 0;
-  while ((iter= tcadbiternext(queue->db, &iter_size)))
+  while (_libtokyocabinet_next(queue->db, cursor, key, data))
   {     
-    tcxstrclear(key);
-    tcxstrclear(data);
-    tcxstrcat(key, iter, iter_size);
-    free(iter);
-    iter= tcadbget(queue->db, tcxstrptr(key), tcxstrsize(key), &iter_size);
-    if (iter == NULL)
-    {
-      gearmand_log_info(GEARMAN_DEFAULT_LOG_PARAM, "libtokyocabinet replay key disappeared: %s", (char *)tcxstrptr(key));
-      continue;
-    }
-    tcxstrcat(data, iter, iter_size);
-    free(iter);
-
     if (_callback_for_record(server, key, data, add_fn, add_context) != GEARMAND_SUCCESS)
     {
       gret= GEARMAND_QUEUE_ERROR;
@@ -450,6 +731,13 @@ static gearmand_error_t _libtokyocabinet_replay(gearman_server_st *server, void
   tcxstrdel(key);
   tcxstrdel(data);
 
+  if (cursor)
+  {
+    tcbdbcurdel((BDBCUR *)cursor);
+  }
+
+  queue->unlock();
+
   gearmand_log_info(GEARMAN_DEFAULT_LOG_PARAM, "libtokyocabinet replayed %ld records", x);
 
   return gret;
@@ -46,9 +46,38 @@
 #include <libgearman-server/plugins/queue/base.h>
 #include <libgearman-server/queue.hpp>
 #include <libgearman-server/log.h>
+#include <libgearman-server/replay.h>
 
 #include <assert.h>
 
+namespace {
+
+// The plugin belongs to a background replay until it has read everything.
+class ReplayLock {
+public:
+  ReplayLock(gearman_server_st *server) :
+    _replay(server->replay and server->replay->running() ? server->replay : NULL)
+  {
+    if (_replay)
+    {
+      _replay->lock();
+    }
+  }
+
+  ~ReplayLock()
+  {
+    if (_replay)
+    {
+      _replay->unlock();
+    }
+  }
+
+private:
+  gearmand::queue::Replay *_replay;
+};
+
+} // namespace
+
 gearmand_error_t gearman_queue_add(gearman_server_st *server,
                                    const char *unique,
                                    size_t unique_size,
@@ -60,6 +89,7 @@ gearmand_error_t gearman_queue_add(gearman_server_st *server,
                                    int64_t when)
 {
   assert(server->state.queue_startup == false);
+  ReplayLock replay_lock(server);
   gearmand_error_t ret;
   if (server->queue_version == QUEUE_VERSION_NONE)
   {
@@ -122,6 +152,10 @@ gearmand_error_t gearman_queue_done(gearman_server_st *server,
   {
     return GEARMAND_SUCCESS;
   }
+  else if (server->replay and server->replay->defer_done(unique, unique_size, function_name, function_name_size))
+  {
+    return GEARMAND_SUCCESS;
+  }
   else if (server->queue_version == QUEUE_VERSION_FUNCTION)
   {
     assert(server->queue.functions->_done_fn);
@@ -141,6 +175,78 @@ gearmand_error_t gearman_queue_done(gearman_server_st *server,
   }
 }
 
+gearmand_error_t gearman_queue_add_batch(gearman_server_st *server,
+                                         const gearmand::queue::job_st *jobs,
+                                         size_t count,
+                                         gearmand::queue::batch_complete_fn *complete,
+                                         void *complete_context)
+{
+  assert(server->state.queue_startup == false);
+  ReplayLock replay_lock(server);
+  if (server->queue_version == QUEUE_VERSION_CLASS)
+  {
+    assert(server->queue.object);
+    return server->queue.object->store_batch(server, jobs, count, complete, complete_context);
+  }
+
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  if (server->queue_version == QUEUE_VERSION_FUNCTION and count)
+  {
+    // Function based plugins only know about single jobs.
+    assert(server->queue.functions->_add_fn);
+    for (size_t x= 0; x < count and gearmand_success(ret); ++x)
+    {
+      ret= (*(server->queue.functions->_add_fn))(server,
+                                                 (void *)server->queue.functions->_context,
+                                                 jobs[x].unique, jobs[x].unique_size,
+                                                 jobs[x].function_name,
+                                                 jobs[x].function_name_size,
+                                                 jobs[x].data, jobs[x].data_size,
+                                                 jobs[x].priority,
+                                                 jobs[x].when);
+    }
+
+    if (gearmand_success(ret))
+    {
+      ret= gearman_queue_flush(server);
+    }
+  }
+
+  if (complete)
+  {
+    complete(ret, complete_context);
+  }
+
+  return ret;
+}
+
+gearmand_error_t gearman_queue_done_batch(gearman_server_st *server,
+                                          const gearmand::queue::job_st *jobs,
+                                          size_t count)
+{
+  // While a background replay runs, gearman_queue_done() defers each delete.
+  if (server->queue_version == QUEUE_VERSION_CLASS and (server->replay == NULL or server->replay->running() == false))
+  {
+    assert(server->queue.object);
+    return server->queue.object->done_batch(server, jobs, count);
+  }
+
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  for (size_t x= 0; x < count; ++x)
+  {
+    gearmand_error_t rc= gearman_queue_done(server,
+                                            jobs[x].unique, jobs[x].unique_size,
+                                            jobs[x].function_name,
+                                            jobs[x].function_name_size);
+    if (gearmand_failed(rc))
+    {
+      ret= rc;
+    }
+  }
+
+  return ret;
+}
+
 void gearman_server_save_job(gearman_server_st& server,
                              const gearman_server_job_st* server_job)
 {
@@ -151,6 +257,17 @@ void gearman_server_save_job(gearman_server_st& server,
   }
 }
 
+gearmand_error_t gearman_server_queue_save(gearman_server_st& server)
+{
+  if (server.queue_version == QUEUE_VERSION_CLASS and server.queue.object->store_on_shutdown())
+  {
+    ReplayLock replay_lock(&server);
+    return server.queue.object->save(server);
+  }
+
+  return GEARMAND_INVALID_ARGUMENT;
+}
+
 void gearman_server_set_queue(gearman_server_st& server,
                               void *context,
                               gearman_queue_add_fn *add,
@@ -39,6 +39,10 @@
 
 #include <libgearman-server/constants.h>
 
+#ifdef __cplusplus
+namespace gearmand { namespace queue { struct job_st; } }
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -64,6 +68,32 @@ gearmand_error_t gearman_queue_done(gearman_server_st *server,
 #ifdef __cplusplus
 void gearman_server_save_job(gearman_server_st& server,
                              const gearman_server_job_st* server_job);
+
+/*
+  Save all queued jobs if the queue stores on shutdown. Returns
+  GEARMAND_INVALID_ARGUMENT if it does not.
+*/
+gearmand_error_t gearman_server_queue_save(gearman_server_st& server);
+
+/*
+  Store a batch of jobs with one flush. complete, if given, is called once
+  with the result of the whole batch, possibly after this returns.
+*/
+gearmand_error_t gearman_queue_add_batch(gearman_server_st *server,
+                                         const gearmand::queue::job_st *jobs,
+                                         size_t count,
+                                         void (*complete)(gearmand_error_t, void *)= NULL,
+                                         void *complete_context= NULL);
+
+gearmand_error_t gearman_queue_done_batch(gearman_server_st *server,
+                                          const gearmand::queue::job_st *jobs,
+                                          size_t count);
+
+/*
+  Run the plugin's replay, every record goes through
+  gearmand::queue::Context::replay_add().
+*/
+gearmand_error_t gearman_queue_replay(gearman_server_st& server);
 #endif
 
 #ifdef __cplusplus
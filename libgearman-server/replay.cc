@@ -0,0 +1,423 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Gearmand client and server library.
+ *
+ *  Copyright (C) 2013 Data Differential, http://datadifferential.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "gear_config.h"
+
+#include "libgearman-server/common.h"
+#include <libgearman-server/queue.h>
+#include <libgearman-server/replay.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+
+/*
+  Records handed to the server thread at a time, which is also the most
+  work done between two commands.
+*/
+#define GEARMAND_REPLAY_BATCH_SIZE 1024
+
+namespace gearmand {
+namespace queue {
+
+Replay::Replay(gearman_server_st& server_) :
+  _server(server_),
+  _thread_running(false),
+  _running(true),
+  _shutdown(false),
+  _state(REPLAY_RUNNING),
+  _read(0),
+  _added(0)
+{
+  (void)pthread_mutex_init(&_lock, NULL);
+  (void)pthread_mutex_init(&_queue_lock, NULL);
+  _batch.reserve(GEARMAND_REPLAY_BATCH_SIZE);
+}
+
+Replay::~Replay()
+{
+  stop();
+
+  // Jobs that never made it into the server are still in the queue.
+  while (_pending.size())
+  {
+    free_batch(_pending.front());
+    _pending.pop_front();
+  }
+  free_batch(_batch);
+
+  apply_dones();
+
+  (void)pthread_mutex_destroy(&_queue_lock);
+  (void)pthread_mutex_destroy(&_lock);
+}
+
+gearmand_error_t Replay::start()
+{
+  int pthread_error;
+  if ((pthread_error= pthread_create(&_thread, NULL, _run, this)))
+  {
+    return gearmand_perror(pthread_error, "pthread_create");
+  }
+  _thread_running= true;
+
+  return GEARMAND_SUCCESS;
+}
+
+void Replay::stop()
+{
+  (void)pthread_mutex_lock(&_lock);
+  _shutdown= true;
+  bool join= _thread_running;
+  _thread_running= false;
+  (void)pthread_mutex_unlock(&_lock);
+
+  if (join)
+  {
+    (void)pthread_join(_thread, NULL);
+  }
+}
+
+gearmand_error_t Replay::collect(const char *unique, size_t unique_size,
+                                 const char *function_name, size_t function_name_size,
+                                 const void *data, size_t data_size,
+                                 gearman_job_priority_t priority,
+                                 int64_t when)
+{
+  _batch.resize(_batch.size() +1);
+  record_st& record= _batch.back();
+  record.unique.assign(unique, unique_size);
+  record.function_name.assign(function_name, function_name_size);
+  record.data= const_cast<void *>(data);
+  record.data_size= data_size;
+  record.priority= priority;
+  record.when= when;
+
+  if (_batch.size() < GEARMAND_REPLAY_BATCH_SIZE)
+  {
+    return GEARMAND_SUCCESS;
+  }
+
+  return push();
+}
+
+gearmand_error_t Replay::push()
+{
+  (void)pthread_mutex_lock(&_lock);
+  bool shutdown= _shutdown;
+  if (shutdown == false)
+  {
+    _read+= _batch.size();
+    _pending.resize(_pending.size() +1);
+    _pending.back().swap(_batch);
+  }
+  (void)pthread_mutex_unlock(&_lock);
+
+  if (shutdown)
+  {
+    // Makes the plugin stop, whatever is left is freed with us.
+    return GEARMAND_SHUTDOWN;
+  }
+
+  _batch.reserve(GEARMAND_REPLAY_BATCH_SIZE);
+  wakeup();
+
+  return GEARMAND_SUCCESS;
+}
+
+void Replay::drain()
+{
+  if (_running == false)
+  {
+    return;
+  }
+
+  batch_t batch;
+  (void)pthread_mutex_lock(&_lock);
+  if (_pending.size())
+  {
+    batch.swap(_pending.front());
+    _pending.pop_front();
+  }
+  bool more= _pending.size();
+  state_t state= _state;
+  (void)pthread_mutex_unlock(&_lock);
+
+  if (batch.size())
+  {
+    // The jobs are already stored, don't store them again.
+    _server.state.queue_startup= true;
+    for (batch_t::iterator iter= batch.begin(); iter != batch.end(); ++iter)
+    {
+      gearmand_error_t ret= GEARMAND_UNKNOWN_STATE;
+      (void)gearman_server_job_add(&_server,
+                                   iter->function_name.c_str(), iter->function_name.size(),
+                                   iter->unique.c_str(), iter->unique.size(),
+                                   iter->data, iter->data_size, iter->priority, NULL, &ret, iter->when);
+
+      if (ret == GEARMAND_JOB_EXISTS)
+      {
+        // Submitted again before the replay got to it.
+        free(iter->data);
+      }
+      else if (gearmand_failed(ret))
+      {
+        gearmand_gerror("gearman_server_job_add", ret);
+      }
+    }
+    _server.state.queue_startup= false;
+
+    _added+= batch.size();
+  }
+
+  if (more)
+  {
+    // Let the connections have a turn before the next batch.
+    wakeup();
+    return;
+  }
+
+  if (state == REPLAY_RUNNING)
+  {
+    return;
+  }
+
+  (void)pthread_mutex_lock(&_lock);
+  bool join= _thread_running;
+  _thread_running= false;
+  (void)pthread_mutex_unlock(&_lock);
+
+  if (join)
+  {
+    (void)pthread_join(_thread, NULL);
+  }
+
+  _running= false;
+  apply_dones();
+
+  gearmand_log_info(GEARMAN_DEFAULT_LOG_PARAM, "background replay %s, added %" PRIu64 " jobs",
+                    strstate(state), _added);
+}
+
+bool Replay::defer_done(const char *unique, size_t unique_size,
+                        const char *function_name, size_t function_name_size)
+{
+  if (_running == false)
+  {
+    return false;
+  }
+
+  _dones.push_back(std::make_pair(std::string(unique, unique_size),
+                                  std::string(function_name, function_name_size)));
+
+  return true;
+}
+
+void Replay::apply_dones()
+{
+  if (_dones.empty())
+  {
+    return;
+  }
+
+  std::vector<job_st> jobs(_dones.size());
+  for (size_t x= 0; x < _dones.size(); ++x)
+  {
+    jobs[x].unique= _dones[x].first.c_str();
+    jobs[x].unique_size= _dones[x].first.size();
+    jobs[x].function_name= _dones[x].second.c_str();
+    jobs[x].function_name_size= _dones[x].second.size();
+  }
+
+  gearmand_error_t ret;
+  if (gearmand_failed(ret= gearman_queue_done_batch(&_server, &jobs[0], jobs.size())))
+  {
+    gearmand_gerror("failed to remove jobs finished during the replay", ret);
+  }
+
+  _dones.clear();
+}
+
+void Replay::progress(state_t& state, uint64_t& read, uint64_t& added)
+{
+  (void)pthread_mutex_lock(&_lock);
+  state= _state;
+  read= _read;
+  (void)pthread_mutex_unlock(&_lock);
+
+  added= _added;
+  if (state != REPLAY_RUNNING and _running)
+  {
+    // Finished reading, not yet done inserting.
+    state= REPLAY_RUNNING;
+  }
+}
+
+const char *Replay::strstate(state_t state)
+{
+  switch (state)
+  {
+  case REPLAY_RUNNING:
+    return "running";
+
+  case REPLAY_FINISHED:
+    return "finished";
+
+  case REPLAY_FAILED:
+    return "failed";
+  }
+
+  return "unknown";
+}
+
+void Replay::wakeup()
+{
+  if (_server.flags.threaded)
+  {
+    int pthread_error;
+    if ((pthread_error= pthread_mutex_lock(&(_server.proc_lock))) == 0)
+    {
+      _server.proc_wakeup= true;
+      (void)pthread_cond_signal(&(_server.proc_cond));
+      (void)pthread_mutex_unlock(&(_server.proc_lock));
+    }
+    else
+    {
+      gearmand_log_fatal_perror(GEARMAN_DEFAULT_LOG_PARAM, pthread_error, "pthread_mutex_lock");
+    }
+  }
+  else if (Gearmand() and Gearmand()->thread_list)
+  {
+    gearmand_thread_wakeup(Gearmand()->thread_list, GEARMAND_WAKEUP_RUN);
+  }
+}
+
+void Replay::free_batch(batch_t& batch)
+{
+  for (batch_t::iterator iter= batch.begin(); iter != batch.end(); ++iter)
+  {
+    free(iter->data);
+  }
+  batch.clear();
+}
+
+void *Replay::_run(void *context)
+{
+  Replay *replay= static_cast<Replay *>(context);
+
+  (void)gearmand_initialize_thread_logging("[ replay ]");
+
+  gearmand_info("background replay start");
+
+  replay->lock();
+  gearmand_error_t ret= gearman_queue_replay(replay->_server);
+  replay->unlock();
+
+  (void)pthread_mutex_lock(&replay->_lock);
+  bool shutdown= replay->_shutdown;
+  if (shutdown == false and replay->_batch.size())
+  {
+    replay->_read+= replay->_batch.size();
+    replay->_pending.resize(replay->_pending.size() +1);
+    replay->_pending.back().swap(replay->_batch);
+  }
+  replay->_state= gearmand_success(ret) ? REPLAY_FINISHED : REPLAY_FAILED;
+  uint64_t read= replay->_read;
+  (void)pthread_mutex_unlock(&replay->_lock);
+
+  if (shutdown)
+  {
+    return NULL;
+  }
+
+  if (gearmand_failed(ret))
+  {
+    gearmand_log_gerror(GEARMAN_DEFAULT_LOG_PARAM, ret, "background replay failed after %" PRIu64 " jobs", read);
+  }
+  else
+  {
+    gearmand_log_info(GEARMAN_DEFAULT_LOG_PARAM, "background replay read %" PRIu64 " jobs", read);
+  }
+
+  replay->wakeup();
+
+  return NULL;
+}
+
+} // namespace queue
+} // namespace gearmand
+
+gearmand_error_t gearman_server_queue_replay_start(gearman_server_st& server)
+{
+  assert(server.replay == NULL);
+  server.replay= new (std::nothrow) gearmand::queue::Replay(server);
+  if (server.replay == NULL)
+  {
+    return gearmand_merror("new", gearmand::queue::Replay, 1);
+  }
+
+  gearmand_error_t ret;
+  if (gearmand_failed(ret= server.replay->start()))
+  {
+    delete server.replay;
+    server.replay= NULL;
+  }
+
+  return ret;
+}
+
+void gearman_server_queue_replay_drain(gearman_server_st& server)
+{
+  if (server.replay)
+  {
+    server.replay->drain();
+  }
+}
+
+void gearman_server_queue_replay_stop(gearman_server_st& server)
+{
+  if (server.replay)
+  {
+    server.replay->stop();
+  }
+}
+
+void gearman_server_queue_replay_free(gearman_server_st& server)
+{
+  delete server.replay;
+  server.replay= NULL;
+}
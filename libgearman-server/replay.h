@@ -0,0 +1,147 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Gearmand client and server library.
+ *
+ *  Copyright (C) 2013 Data Differential, http://datadifferential.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+  Background replay of the persistent queue.
+
+  The replay thread runs the plugin's replay() and copies every record into
+  batches. The thread that runs commands (the processing thread, or the only
+  I/O thread when not threaded) inserts one batch at a time between commands,
+  so the server accepts work while the queue is still being loaded.
+
+  The plugin belongs to the replay thread until its replay() returns. Until
+  then queue writes from the server wait on lock(), and deletes are deferred
+  and applied as a single batch afterwards.
+*/
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+namespace gearmand {
+namespace queue {
+
+class Replay {
+public:
+  enum state_t {
+    REPLAY_RUNNING,
+    REPLAY_FINISHED,
+    REPLAY_FAILED
+  };
+
+  Replay(gearman_server_st& server);
+
+  ~Replay();
+
+  gearmand_error_t start();
+
+  void stop();
+
+  // Replay thread: take a record from the plugin, the data becomes ours.
+  gearmand_error_t collect(const char *unique, size_t unique_size,
+                           const char *function_name, size_t function_name_size,
+                           const void *data, size_t data_size,
+                           gearman_job_priority_t priority,
+                           int64_t when);
+
+  // Server thread: insert the next batch.
+  void drain();
+
+  // Server thread: true if the delete was deferred until the replay is done.
+  bool defer_done(const char *unique, size_t unique_size,
+                  const char *function_name, size_t function_name_size);
+
+  // True until the server thread has seen the end of the replay.
+  bool running() const
+  {
+    return _running;
+  }
+
+  void lock()
+  {
+    (void)pthread_mutex_lock(&_queue_lock);
+  }
+
+  void unlock()
+  {
+    (void)pthread_mutex_unlock(&_queue_lock);
+  }
+
+  void progress(state_t& state, uint64_t& read, uint64_t& added);
+
+  static const char *strstate(state_t state);
+
+private:
+  struct record_st {
+    std::string unique;
+    std::string function_name;
+    void *data;
+    size_t data_size;
+    gearman_job_priority_t priority;
+    int64_t when;
+  };
+  typedef std::vector<record_st> batch_t;
+
+  static void *_run(void *context);
+  gearmand_error_t push();
+  void wakeup();
+  void apply_dones();
+  void free_batch(batch_t&);
+
+  gearman_server_st& _server;
+  pthread_t _thread;
+  bool _thread_running;
+  bool _running;
+  bool _shutdown;
+  state_t _state;
+  uint64_t _read;
+  uint64_t _added;
+  batch_t _batch;
+  std::deque<batch_t> _pending;
+  std::vector<std::pair<std::string, std::string> > _dones;
+  // Guards _pending, _shutdown, _state and the counters.
+  pthread_mutex_t _lock;
+  // Held by the replay thread while the plugin is replaying.
+  pthread_mutex_t _queue_lock;
+};
+
+} // namespace queue
+} // namespace gearmand
@@ -0,0 +1,334 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Gearmand client and server library.
+ *
+ *  Copyright (C) 2013 Data Differential, http://datadifferential.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "gear_config.h"
+
+#include "libgearman-server/common.h"
+#include <libgearman-server/scheduler.h>
+#include <libgearman-server/timer.h>
+
+#include <cstring>
+#include <ctime>
+#include <memory>
+
+gearman_server_job_st *gearman_server_job_take_from(gearman_server_worker_st *server_worker,
+                                                    gearman_job_priority_t priority)
+{
+  if (gearman_server_function_at_capacity(server_worker->function))
+  {
+    return NULL;
+  }
+
+  gearman_server_job_st *server_job= server_worker->function->job_list[priority];
+  gearman_server_job_st *previous_job= server_job;
+
+  int64_t current_time= (int64_t)time(NULL);
+
+  while (server_job and server_job->when != 0 and server_job->when > current_time)
+  {
+    previous_job= server_job;
+    server_job= server_job->function_next;  
+  }
+
+  if (server_job)
+  { 
+    if (server_job->function->job_list[priority] == server_job)
+    {
+      // If it's the head of the list, advance it
+      server_job->function->job_list[priority]= server_job->function_next;
+    }
+    else
+    {
+      // Otherwise, just remove the item from the list
+      previous_job->function_next= server_job->function_next;
+    }
+
+    // If it's the tail of the list, move the tail back
+    if (server_job->function->job_end[priority] == server_job)
+    {
+      server_job->function->job_end[priority]= previous_job;
+    }
+    if (--server_job->function->job_count == 0)
+    {
+      gearman_server_worker_idle_function(server_job->function);
+    }
+
+    server_job->worker= server_worker;
+    GEARMAND_LIST_ADD(server_worker->job, server_job, worker_);
+    server_worker->con->job_running++;
+    server_job->function->job_running++;
+  }
+
+  return server_job;
+}
+
+namespace gearmand {
+
+namespace {
+
+class PriorityScheduler : public Scheduler {
+public:
+  const char *name() const
+  {
+    return "priority";
+  }
+
+  gearman_server_job_st *take(gearman_server_con_st *server_con);
+
+private:
+  gearman_server_job_st *take_round_robin(gearman_server_con_st *server_con);
+};
+
+static gearman_job_priority_t _first_priority(const gearman_server_function_st *function)
+{
+  gearman_job_priority_t priority;
+  for (priority= GEARMAN_JOB_PRIORITY_HIGH; priority < GEARMAN_JOB_PRIORITY_LOW;
+       priority= gearman_job_priority_t(int(priority) +1))
+  {
+    if (function->job_list[priority])
+    {
+      break;
+    }
+  }
+
+  return priority;
+}
+
+gearman_server_job_st *PriorityScheduler::take(gearman_server_con_st *server_con)
+{
+  if (Server->flags.round_robin)
+  {
+    return take_round_robin(server_con);
+  }
+
+  for (gearman_server_worker_st *server_worker= server_con->worker_list; server_worker; server_worker= server_worker->con_next)
+  {
+    if (server_worker->function and server_worker->function->job_count)
+    {
+      gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "Jobs available for %.*s: %lu",
+                         (int)server_worker->function->function_name_size, server_worker->function->function_name,
+                         (unsigned long)(server_worker->function->job_count));
+
+      gearman_server_job_st *server_job= gearman_server_job_take_from(server_worker,
+                                                                      _first_priority(server_worker->function));
+      if (server_job)
+      {
+        return server_job;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/*
+  Only workers whose function has queued jobs are in the ready list, so
+  moving the served worker to the back is just advancing the head.
+*/
+gearman_server_job_st *PriorityScheduler::take_round_robin(gearman_server_con_st *server_con)
+{
+  const uint32_t ready_count= server_con->ready_count;
+  for (uint32_t visited= 0; visited < ready_count and server_con->ready_list; ++visited)
+  {
+    gearman_server_worker_st *server_worker= server_con->ready_list;
+    server_con->ready_list= server_worker->ready_next;
+
+    gearman_server_job_st *server_job= gearman_server_job_take_from(server_worker,
+                                                                    _first_priority(server_worker->function));
+    if (server_job)
+    {
+      return server_job;
+    }
+  }
+
+  return NULL;
+}
+
+class FairScheduler : public Scheduler {
+public:
+  FairScheduler(const uint32_t (&priority_weights)[GEARMAN_JOB_PRIORITY_MAX], uint32_t priority_aging) :
+    _priority_aging(priority_aging)
+  {
+    for (int priority= 0; priority < GEARMAN_JOB_PRIORITY_MAX; ++priority)
+    {
+      _priority_weights[priority]= priority_weights[priority] ? priority_weights[priority] : 1;
+    }
+  }
+
+  const char *name() const
+  {
+    return "fair";
+  }
+
+  gearman_server_job_st *take(gearman_server_con_st *server_con);
+
+private:
+  gearman_server_job_st *take_aged(gearman_server_worker_st *server_worker);
+  gearman_server_job_st *take_from_function(gearman_server_worker_st *server_worker);
+
+  uint32_t _priority_weights[GEARMAN_JOB_PRIORITY_MAX];
+  uint32_t _priority_aging;
+};
+
+/*
+  Deficit round robin over the ready workers of the connection, one per
+  function. The worker at the head keeps getting jobs until it has used up
+  its function's weight, then the head moves on. A worker that runs out of
+  jobs has already left the list when the take returns.
+*/
+gearman_server_job_st *FairScheduler::take(gearman_server_con_st *server_con)
+{
+  const uint32_t ready_count= server_con->ready_count;
+  for (uint32_t visited= 0; visited < ready_count and server_con->ready_list; ++visited)
+  {
+    gearman_server_worker_st *server_worker= server_con->ready_list;
+
+    if (server_worker->deficit == 0)
+    {
+      server_worker->deficit= server_worker->function->weight ? server_worker->function->weight : 1;
+    }
+
+    gearman_server_job_st *server_job= take_from_function(server_worker);
+    if (server_job)
+    {
+      if (server_worker->ready_next and --server_worker->deficit == 0 and server_con->ready_list == server_worker)
+      {
+        server_con->ready_list= server_worker->ready_next;
+      }
+
+      return server_job;
+    }
+
+    server_worker->deficit= 0;
+    server_con->ready_list= server_worker->ready_next;
+  }
+
+  return NULL;
+}
+
+// The head of each list is its oldest job, take the oldest one past the limit.
+gearman_server_job_st *FairScheduler::take_aged(gearman_server_worker_st *server_worker)
+{
+  gearman_server_function_st *function= server_worker->function;
+  const int64_t now= int64_t(libgearman::server::Epoch::current().tv_sec);
+
+  int aged= GEARMAN_JOB_PRIORITY_MAX;
+  for (int priority= GEARMAN_JOB_PRIORITY_HIGH; priority < GEARMAN_JOB_PRIORITY_MAX; ++priority)
+  {
+    gearman_server_job_st *head= function->job_list[priority];
+    if (head and now -head->queued_at >= int64_t(_priority_aging) and
+        (aged == GEARMAN_JOB_PRIORITY_MAX or head->queued_at < function->job_list[aged]->queued_at))
+    {
+      aged= priority;
+    }
+  }
+
+  if (aged == GEARMAN_JOB_PRIORITY_MAX)
+  {
+    return NULL;
+  }
+
+  return gearman_server_job_take_from(server_worker, gearman_job_priority_t(aged));
+}
+
+/*
+  Deficit round robin over the priorities of the function, shared by all of
+  its workers.
+*/
+gearman_server_job_st *FairScheduler::take_from_function(gearman_server_worker_st *server_worker)
+{
+  gearman_server_function_st *function= server_worker->function;
+
+  if (_priority_aging)
+  {
+    gearman_server_job_st *server_job;
+    if ((server_job= take_aged(server_worker)))
+    {
+      return server_job;
+    }
+  }
+
+  for (int visited= 0; visited < GEARMAN_JOB_PRIORITY_MAX; ++visited)
+  {
+    const gearman_job_priority_t priority= function->priority_cursor;
+
+    if (function->job_list[priority])
+    {
+      if (function->priority_deficit[priority] == 0)
+      {
+        function->priority_deficit[priority]= _priority_weights[priority];
+      }
+
+      gearman_server_job_st *server_job= gearman_server_job_take_from(server_worker, priority);
+      if (server_job)
+      {
+        if (--function->priority_deficit[priority] == 0)
+        {
+          function->priority_cursor= gearman_job_priority_t((int(priority) +1) % GEARMAN_JOB_PRIORITY_MAX);
+        }
+
+        return server_job;
+      }
+    }
+
+    function->priority_deficit[priority]= 0;
+    function->priority_cursor= gearman_job_priority_t((int(priority) +1) % GEARMAN_JOB_PRIORITY_MAX);
+  }
+
+  return NULL;
+}
+
+} // namespace
+
+Scheduler *Scheduler::create(const std::string& name,
+                             const uint32_t (&priority_weights)[GEARMAN_JOB_PRIORITY_MAX],
+                             uint32_t priority_aging)
+{
+  if (name.empty() or name.compare("priority") == 0)
+  {
+    return new (std::nothrow) PriorityScheduler();
+  }
+
+  if (name.compare("fair") == 0)
+  {
+    return new (std::nothrow) FairScheduler(priority_weights, priority_aging);
+  }
+
+  return NULL;
+}
+
+} // namespace gearmand
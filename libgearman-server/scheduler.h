@@ -0,0 +1,84 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Gearmand client and server library.
+ *
+ *  Copyright (C) 2013 Data Differential, http://datadifferential.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+  Job schedulers.
+
+  A scheduler decides which job a worker connection gets next. "priority" is
+  the original behaviour: the first function of the connection that has jobs,
+  always draining HIGH before NORMAL before LOW (functions rotate with
+  --round-robin). "fair" uses deficit round robin twice: across the functions
+  of the connection, weighted by each function's weight, and across the
+  priorities of a function, weighted by --priority-weights. With
+  --priority-aging a job that waited that many seconds at the head of its
+  list is taken before anything else.
+*/
+
+#pragma once
+
+#include <string>
+
+namespace gearmand {
+
+class Scheduler {
+public:
+  virtual ~Scheduler()
+  {
+  }
+
+  virtual const char *name() const= 0;
+
+  /*
+    Pick a job for one of the connection's workers, take it off its queue
+    and assign it to that worker. Returns NULL if there is nothing to run.
+  */
+  virtual gearman_server_job_st *take(gearman_server_con_st *server_con)= 0;
+
+  // NULL if name is not a known scheduler.
+  static Scheduler *create(const std::string& name,
+                           const uint32_t (&priority_weights)[GEARMAN_JOB_PRIORITY_MAX],
+                           uint32_t priority_aging);
+};
+
+} // namespace gearmand
+
+/*
+  Take the first job from a priority list of the worker's function that is
+  due to run, and assign it to the worker.
+*/
+gearman_server_job_st *gearman_server_job_take_from(gearman_server_worker_st *server_worker,
+                                                    gearman_job_priority_t priority);
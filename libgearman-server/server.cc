@@ -46,12 +46,14 @@
 #include "libgearman-server/common.h"
 #include "libgearman-server/queue.h"
 #include "libgearman-server/plugins/base.h"
+#include "libgearman-server/replay.h"
 
 #include <cerrno>
 #include <climits>
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <vector>
 
 #include "libgearman-1.0/return.h"
 #include "libgearman-1.0/strerror.h"
@@ -94,6 +96,15 @@ static gearmand_error_t
 _server_queue_work_data(gearman_server_job_st *server_job,
                         gearmand_packet_st *packet, gearman_command_t command);
 
+static gearmand_error_t _server_job_assign(gearman_server_con_st *server_con,
+                                           gearman_command_t command,
+                                           gearman_server_job_st *server_job);
+
+static gearmand_error_t _server_con_fill(gearman_server_con_st *server_con);
+
+static gearmand_error_t _server_submit_batch(gearman_server_con_st *server_con,
+                                             gearmand_packet_st *packet);
+
 /** @} */
 
 /*
@@ -170,6 +181,7 @@ gearmand_error_t gearman_server_run_command(gearman_server_con_st *server_con,
       if (gearmand_success(ret))
       {
         packet->options.free_data= false;
+        gearman_server_job_set_ttl(server_job, server_con->job_ttl);
       }
       else if (ret == GEARMAND_JOB_QUEUE_FULL)
       {
@@ -289,6 +301,7 @@ gearmand_error_t gearman_server_run_command(gearman_server_con_st *server_con,
       if (gearmand_success(ret))
       {
         packet->options.free_data= false;
+        gearman_server_job_set_ttl(server_job, server_con->job_ttl);
       }
       else if (ret == GEARMAND_JOB_QUEUE_FULL)
       {
@@ -321,6 +334,70 @@ gearmand_error_t gearman_server_run_command(gearman_server_con_st *server_con,
     }
     break;
 
+  case GEARMAN_COMMAND_SUBMIT_JOB_BATCH:
+    ret= _server_submit_batch(server_con, packet);
+    if (gearmand_failed(ret))
+    {
+      return ret;
+    }
+    break;
+
+  /*
+    Nothing is sent back for SUBMIT_JOB_NOREPLY, the outcome is only counted
+    until the client asks for it with NOREPLY_ACK_REQ.
+  */
+  case GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY:
+    {
+      gearman_server_job_st *server_job= NULL;
+      if (packet->arg_size[1] -1 <= GEARMAN_UNIQUE_SIZE)
+      {
+        server_job= gearman_server_job_add(Server,
+                                           (char *)(packet->arg[0]), packet->arg_size[0] -1, // Function
+                                           (char *)(packet->arg[1]), packet->arg_size[1] -1, // unique
+                                           packet->data, packet->data_size, GEARMAN_JOB_PRIORITY_NORMAL,
+                                           NULL, &ret, 0);
+      }
+
+      if (server_job == NULL)
+      {
+        server_con->noreply_refused++;
+        gearmand_log_warning(GEARMAN_DEFAULT_LOG_PARAM, "refused,%.*s,%.*s",
+                             packet->arg_size[0], packet->arg[0], // Function
+                             packet->arg_size[1], packet->arg[1]); // Unique
+        break;
+      }
+
+      if (gearmand_success(ret))
+      {
+        packet->options.free_data= false;
+        gearman_server_job_set_ttl(server_job, server_con->job_ttl);
+      }
+      server_con->noreply_accepted++;
+    }
+    break;
+
+  case GEARMAN_COMMAND_NOREPLY_ACK_REQ:
+    {
+      char accepted_buffer[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+      int accepted_length= snprintf(accepted_buffer, sizeof(accepted_buffer), "%" PRIu64, server_con->noreply_accepted);
+      char refused_buffer[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+      int refused_length= snprintf(refused_buffer, sizeof(refused_buffer), "%" PRIu64, server_con->noreply_refused);
+
+      ret= gearman_server_io_packet_add(server_con, false, GEARMAN_MAGIC_RESPONSE,
+                                        GEARMAN_COMMAND_NOREPLY_ACK_RES,
+                                        accepted_buffer, size_t(accepted_length +1),
+                                        refused_buffer, size_t(refused_length),
+                                        NULL);
+      if (gearmand_failed(ret))
+      {
+        return gearmand_gerror("gearman_server_io_packet_add", ret);
+      }
+
+      server_con->noreply_accepted= 0;
+      server_con->noreply_refused= 0;
+    }
+    break;
+
   case GEARMAN_COMMAND_GET_STATUS_UNIQUE:
     {
       char unique_handle[GEARMAN_MAX_UNIQUE_SIZE];
@@ -499,6 +576,36 @@ gearmand_error_t gearman_server_run_command(gearman_server_con_st *server_con,
         gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "'exceptions'");
         server_con->is_exceptions= true;
       }
+      else if (strncasecmp(option, "capacity=", sizeof("capacity=") -1) == 0)
+      {
+        char *endptr;
+        errno= 0;
+        unsigned long capacity= strtoul(option +sizeof("capacity=") -1, &endptr, 10);
+        if (errno or *endptr or endptr == option +sizeof("capacity=") -1 or
+            capacity == 0 or capacity > GEARMAND_MAX_WORKER_CAPACITY)
+        {
+          return _server_error_packet(GEARMAN_DEFAULT_LOG_PARAM, server_con, GEARMAN_INVALID_ARGUMENT,
+                                      gearman_literal_param("Capacity must be a number of jobs from 1 to 65535"));
+        }
+
+        gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "'capacity' %lu", capacity);
+        server_con->capacity= uint32_t(capacity);
+      }
+      else if (strncasecmp(option, "ttl=", sizeof("ttl=") -1) == 0)
+      {
+        char *endptr;
+        errno= 0;
+        unsigned long long ttl= strtoull(option +sizeof("ttl=") -1, &endptr, 10);
+        if (errno or *endptr or endptr == option +sizeof("ttl=") -1 or
+            ttl > UINT32_MAX)
+        {
+          return _server_error_packet(GEARMAN_DEFAULT_LOG_PARAM, server_con, GEARMAN_INVALID_ARGUMENT,
+                                      gearman_literal_param("TTL must be a number of seconds"));
+        }
+
+        gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "'ttl' %llu", ttl);
+        server_con->job_ttl= uint32_t(ttl);
+      }
       else
       {
         return _server_error_packet(GEARMAN_DEFAULT_LOG_PARAM, server_con, GEARMAN_UNKNOWN_OPTION,
@@ -575,8 +682,6 @@ gearmand_error_t gearman_server_run_command(gearman_server_con_st *server_con,
       if (server_job == NULL)
       {
         server_con->is_sleeping= true;
-        /* Remove any timeouts while sleeping */
-        gearman_server_con_delete_timeout(server_con);
       }
       else
       {
@@ -601,95 +706,117 @@ gearmand_error_t gearman_server_run_command(gearman_server_con_st *server_con,
       server_con->is_sleeping= false;
       server_con->is_noop_sent= false;
 
-      gearman_server_job_st *server_job= gearman_server_job_take(server_con);
+      server_con->grab_command= packet->command;
+
+      gearman_server_job_st *server_job= NULL;
+      if (gearman_server_con_is_full(server_con) == false)
+      {
+        server_job= gearman_server_job_take(server_con);
+      }
+
       if (server_job == NULL)
       {
         /* No jobs found, queue no job packet. */
         ret= gearman_server_io_packet_add(server_con, false,
                                           GEARMAN_MAGIC_RESPONSE,
                                           GEARMAN_COMMAND_NO_JOB, NULL);
+        if (gearmand_failed(ret))
+        {
+          return gearmand_gerror("gearman_server_io_packet_add", ret);
+        }
       }
-      else if (packet->command == GEARMAN_COMMAND_GRAB_JOB_UNIQ)
+      else
       {
-        /* 
-          We found a runnable job, queue job assigned packet and take the job off the queue. 
-        */
-        ret= gearman_server_io_packet_add(server_con, false,
-                                          GEARMAN_MAGIC_RESPONSE,
-                                          GEARMAN_COMMAND_JOB_ASSIGN_UNIQ,
-                                          server_job->job_handle, (size_t)(strlen(server_job->job_handle) + 1),
-                                          server_job->function->function_name, server_job->function->function_name_size + 1,
-                                          server_job->unique, (size_t)(server_job->unique_length + 1),
-                                          server_job->data, server_job->data_size,
-                                          NULL);
+        ret= _server_job_assign(server_con, packet->command, server_job);
+        if (gearmand_failed(ret))
+        {
+          return ret;
+        }
+
+        /* A worker that declared a capacity gets its other free slots filled too. */
+        ret= _server_con_fill(server_con);
+        if (gearmand_failed(ret))
+        {
+          return ret;
+        }
       }
-      else if (packet->command == GEARMAN_COMMAND_GRAB_JOB_ALL and *server_job->reducer != '\0')
-      {
-        gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,
-                           "Sending reduce submission, Partitioner: %.*s(%lu) Reducer: %.*s(%lu) Unique: %.*s(%lu) with data sized (%lu)" ,
-                           server_job->function->function_name_size, server_job->function->function_name, server_job->function->function_name_size,
-                           strlen(server_job->reducer), server_job->reducer, strlen(server_job->reducer),
-                           server_job->unique_length, server_job->unique, server_job->unique_length,
-                           (unsigned long)server_job->data_size);
-        /* 
-          We found a runnable job, queue job assigned packet and take the job off the queue. 
-        */
-        ret= gearman_server_io_packet_add(server_con, false,
-                                          GEARMAN_MAGIC_RESPONSE,
-                                          GEARMAN_COMMAND_JOB_ASSIGN_ALL,
-                                          server_job->job_handle, (size_t)(strlen(server_job->job_handle) + 1),
-                                          server_job->function->function_name, server_job->function->function_name_size + 1,
-                                          server_job->unique, server_job->unique_length +1,
-                                          server_job->reducer, (size_t)(strlen(server_job->reducer) +1),
-                                          server_job->data, server_job->data_size,
-                                          NULL);
+    }
+
+    break;
+
+  case GEARMAN_COMMAND_GRAB_JOB_MULTI:
+    {
+      if (packet->arg_size[0] > GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH)
+      {
+        return _server_error_packet(GEARMAN_DEFAULT_LOG_PARAM, server_con, GEARMAN_INVALID_ARGUMENT,
+                                    gearman_literal_param("GRAB_JOB_MULTI takes a number of jobs"));
       }
-      else if (packet->command == GEARMAN_COMMAND_GRAB_JOB_ALL)
+
+      char strtoul_buffer[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+      memcpy(strtoul_buffer, packet->arg[0], packet->arg_size[0]);
+      strtoul_buffer[packet->arg_size[0]]= 0;
+      char *endptr;
+      errno= 0;
+      unsigned long count= strtoul(strtoul_buffer, &endptr, 10);
+      if (errno or *endptr or endptr == strtoul_buffer or count == 0)
       {
-        /* 
-          We found a runnable job, queue job assigned packet and take the job off the queue. 
-        */
-        ret= gearman_server_io_packet_add(server_con, false,
-                                          GEARMAN_MAGIC_RESPONSE,
-                                          GEARMAN_COMMAND_JOB_ASSIGN_UNIQ,
-                                          server_job->job_handle, (size_t)(strlen(server_job->job_handle) +1),
-                                          server_job->function->function_name, server_job->function->function_name_size +1,
-                                          server_job->unique, server_job->unique_length +1,
-                                          server_job->data, server_job->data_size,
-                                          NULL);
+        return _server_error_packet(GEARMAN_DEFAULT_LOG_PARAM, server_con, GEARMAN_INVALID_ARGUMENT,
+                                    gearman_literal_param("GRAB_JOB_MULTI takes a number of jobs"));
       }
-      else
+
+      if (count > GEARMAND_MAX_GRAB_JOB_MULTI)
       {
-        gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,
-                           "Sending GEARMAN_COMMAND_JOB_ASSIGN Function: %.*s(%lu) with data sized (%lu)" ,
-                           server_job->function->function_name_size, server_job->function->function_name, server_job->function->function_name_size,
-                           (unsigned long)server_job->data_size);
-        /* Same, but without unique ID. */
-        ret= gearman_server_io_packet_add(server_con, false,
-                                          GEARMAN_MAGIC_RESPONSE,
-                                          GEARMAN_COMMAND_JOB_ASSIGN,
-                                          server_job->job_handle, (size_t)(strlen(server_job->job_handle) + 1),
-                                          server_job->function->function_name, server_job->function->function_name_size + 1,
-                                          server_job->data, server_job->data_size,
-                                          NULL);
+        count= GEARMAND_MAX_GRAB_JOB_MULTI;
       }
 
-      if (gearmand_failed(ret))
+      server_con->is_sleeping= false;
+      server_con->is_noop_sent= false;
+
+      server_con->grab_command= packet->command;
+
+      /* The count goes out ahead of the jobs, so take them all first. */
+      gearman_server_job_st *server_jobs[GEARMAND_MAX_GRAB_JOB_MULTI];
+      uint32_t taken= 0;
+      while (taken < count and gearman_server_con_is_full(server_con) == false)
       {
-        gearmand_gerror("gearman_server_io_packet_add", ret);
+        server_jobs[taken]= gearman_server_job_take(server_con);
+        if (server_jobs[taken] == NULL)
+        {
+          break;
+        }
+        taken++;
+      }
 
-        if (server_job)
+      char count_buffer[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+      int count_length= snprintf(count_buffer, sizeof(count_buffer), "%u", taken);
+
+      ret= gearman_server_io_packet_add(server_con, false,
+                                        GEARMAN_MAGIC_RESPONSE,
+                                        GEARMAN_COMMAND_JOB_ASSIGN_MULTI,
+                                        count_buffer, size_t(count_length),
+                                        NULL);
+      if (gearmand_failed(ret))
+      {
+        for (uint32_t x= 0; x < taken; x++)
         {
-          return gearman_server_job_queue(server_job);
+          gearman_server_job_queue(server_jobs[x]);
         }
 
-        return ret;
+        return gearmand_gerror("gearman_server_io_packet_add", ret);
       }
 
-      /* Since job is assigned, we should respect function timeout */
-      if (server_job != NULL)
+      for (uint32_t x= 0; x < taken; x++)
       {
-        gearman_server_con_add_job_timeout(server_con, server_job);
+        ret= _server_job_assign(server_con, packet->command, server_jobs[x]);
+        if (gearmand_failed(ret))
+        {
+          while (++x < taken)
+          {
+            gearman_server_job_queue(server_jobs[x]);
+          }
+
+          return ret;
+        }
       }
     }
 
@@ -799,6 +926,12 @@ gearmand_error_t gearman_server_run_command(gearman_server_con_st *server_con,
 
       /* Job is done, remove it. */
       gearman_server_job_free(server_job);
+
+      ret= _server_con_fill(server_con);
+      if (gearmand_failed(ret))
+      {
+        return ret;
+      }
     }
     break;
 
@@ -839,6 +972,12 @@ gearmand_error_t gearman_server_run_command(gearman_server_con_st *server_con,
 
       /* Job is done, remove it. */
       gearman_server_job_free(server_job);
+
+      ret= _server_con_fill(server_con);
+      if (gearmand_failed(ret))
+      {
+        return ret;
+      }
     }
 
     break;
@@ -896,6 +1035,12 @@ gearmand_error_t gearman_server_run_command(gearman_server_con_st *server_con,
 
       /* Job is done, remove it. */
       gearman_server_job_free(server_job);
+
+      ret= _server_con_fill(server_con);
+      if (gearmand_failed(ret))
+      {
+        return ret;
+      }
     }
 
     break;
@@ -923,6 +1068,9 @@ gearmand_error_t gearman_server_run_command(gearman_server_con_st *server_con,
   case GEARMAN_COMMAND_JOB_ASSIGN_ALL:
   case GEARMAN_COMMAND_MAX:
   case GEARMAN_COMMAND_STATUS_RES_UNIQUE:
+  case GEARMAN_COMMAND_JOB_ASSIGN_MULTI:
+  case GEARMAN_COMMAND_JOB_CREATED_BATCH:
+  case GEARMAN_COMMAND_NOREPLY_ACK_RES:
   default:
     return _server_error_packet(GEARMAN_DEFAULT_LOG_PARAM, server_con, GEARMAN_INVALID_COMMAND, gearman_literal_param("Command not expected"));
   }
@@ -942,9 +1090,9 @@ gearmand_error_t gearman_server_shutdown_graceful(gearman_server_st *server)
   return GEARMAND_SHUTDOWN_GRACEFUL;
 }
 
-static gearmand_error_t gearman_queue_replay(gearman_server_st& server)
+gearmand_error_t gearman_queue_replay(gearman_server_st& server)
 {
-  assert(server.state.queue_startup == true);
+  assert(server.state.queue_startup == true or server.replay);
   if (server.queue_version == QUEUE_VERSION_FUNCTION)
   {
     assert(server.queue.functions->_replay_fn);
@@ -992,6 +1140,14 @@ gearmand_error_t Context::replay_add(gearman_server_st *server,
                                      gearman_job_priority_t priority,
                                      int64_t when)
 {
+  if (server->replay)
+  {
+    // Background replay, the server thread adds the job later.
+    return server->replay->collect(unique, unique_size,
+                                   function_name, function_name_size,
+                                   data, data_size, priority, when);
+  }
+
   assert(server->state.queue_startup == true);
   gearmand_error_t ret= GEARMAND_UNKNOWN_STATE;
 
@@ -1008,6 +1164,33 @@ gearmand_error_t Context::replay_add(gearman_server_st *server,
   return ret;
 }
 
+gearmand_error_t Context::replay_add_batch(gearman_server_st *server,
+                                           const job_st *jobs, size_t count)
+{
+  size_t x= 0;
+  gearmand_error_t ret= GEARMAND_SUCCESS;
+  for (; x < count; ++x)
+  {
+    if (gearmand_failed(ret= replay_add(server, NULL,
+                                        jobs[x].unique, jobs[x].unique_size,
+                                        jobs[x].function_name, jobs[x].function_name_size,
+                                        jobs[x].data, jobs[x].data_size,
+                                        jobs[x].priority, jobs[x].when)))
+    {
+      // The failed job is handled exactly as a single replay_add() would be.
+      ++x;
+      break;
+    }
+  }
+
+  for (; x < count; ++x)
+  {
+    free((void *)jobs[x].data);
+  }
+
+  return ret;
+}
+
 } // namespace queue
 } // namespace gearmand
 
@@ -1015,6 +1198,253 @@ gearmand_error_t Context::replay_add(gearman_server_st *server,
  * Private definitions
  */
 
+/**
+ * Queue the assign packet for a job taken by a worker, in the flavour of the
+ * GRAB_JOB command it sent. GRAB_JOB_MULTI gets the GRAB_JOB_ALL flavour.
+ */
+static gearmand_error_t _server_job_assign(gearman_server_con_st *server_con,
+                                           gearman_command_t command,
+                                           gearman_server_job_st *server_job)
+{
+  gearmand_error_t ret;
+  if (command == GEARMAN_COMMAND_GRAB_JOB_UNIQ)
+  {
+    /* 
+      We found a runnable job, queue job assigned packet and take the job off the queue. 
+    */
+    ret= gearman_server_io_packet_add(server_con, false,
+                                      GEARMAN_MAGIC_RESPONSE,
+                                      GEARMAN_COMMAND_JOB_ASSIGN_UNIQ,
+                                      server_job->job_handle, (size_t)(strlen(server_job->job_handle) + 1),
+                                      server_job->function->function_name, server_job->function->function_name_size + 1,
+                                      server_job->unique, (size_t)(server_job->unique_length + 1),
+                                      server_job->data, server_job->data_size,
+                                      NULL);
+  }
+  else if ((command == GEARMAN_COMMAND_GRAB_JOB_ALL or command == GEARMAN_COMMAND_GRAB_JOB_MULTI) and
+           *server_job->reducer != '\0')
+  {
+    gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,
+                       "Sending reduce submission, Partitioner: %.*s(%lu) Reducer: %.*s(%lu) Unique: %.*s(%lu) with data sized (%lu)" ,
+                       server_job->function->function_name_size, server_job->function->function_name, server_job->function->function_name_size,
+                       strlen(server_job->reducer), server_job->reducer, strlen(server_job->reducer),
+                       server_job->unique_length, server_job->unique, server_job->unique_length,
+                       (unsigned long)server_job->data_size);
+    /* 
+      We found a runnable job, queue job assigned packet and take the job off the queue. 
+    */
+    ret= gearman_server_io_packet_add(server_con, false,
+                                      GEARMAN_MAGIC_RESPONSE,
+                                      GEARMAN_COMMAND_JOB_ASSIGN_ALL,
+                                      server_job->job_handle, (size_t)(strlen(server_job->job_handle) + 1),
+                                      server_job->function->function_name, server_job->function->function_name_size + 1,
+                                      server_job->unique, server_job->unique_length +1,
+                                      server_job->reducer, (size_t)(strlen(server_job->reducer) +1),
+                                      server_job->data, server_job->data_size,
+                                      NULL);
+  }
+  else if (command == GEARMAN_COMMAND_GRAB_JOB_ALL or command == GEARMAN_COMMAND_GRAB_JOB_MULTI)
+  {
+    /* 
+      We found a runnable job, queue job assigned packet and take the job off the queue. 
+    */
+    ret= gearman_server_io_packet_add(server_con, false,
+                                      GEARMAN_MAGIC_RESPONSE,
+                                      GEARMAN_COMMAND_JOB_ASSIGN_UNIQ,
+                                      server_job->job_handle, (size_t)(strlen(server_job->job_handle) +1),
+                                      server_job->function->function_name, server_job->function->function_name_size +1,
+                                      server_job->unique, server_job->unique_length +1,
+                                      server_job->data, server_job->data_size,
+                                      NULL);
+  }
+  else
+  {
+    gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM,
+                       "Sending GEARMAN_COMMAND_JOB_ASSIGN Function: %.*s(%lu) with data sized (%lu)" ,
+                       server_job->function->function_name_size, server_job->function->function_name, server_job->function->function_name_size,
+                       (unsigned long)server_job->data_size);
+    /* Same, but without unique ID. */
+    ret= gearman_server_io_packet_add(server_con, false,
+                                      GEARMAN_MAGIC_RESPONSE,
+                                      GEARMAN_COMMAND_JOB_ASSIGN,
+                                      server_job->job_handle, (size_t)(strlen(server_job->job_handle) + 1),
+                                      server_job->function->function_name, server_job->function->function_name_size + 1,
+                                      server_job->data, server_job->data_size,
+                                      NULL);
+  }
+
+  if (gearmand_failed(ret))
+  {
+    gearmand_gerror("gearman_server_io_packet_add", ret);
+
+    return gearman_server_job_queue(server_job);
+  }
+
+  /* Since job is assigned, we should respect function timeout */
+  gearman_server_con_add_job_timeout(server_con, server_job);
+
+  return GEARMAND_SUCCESS;
+}
+
+/**
+ * Push jobs to a worker that declared a capacity until it is full or nothing
+ * is left for it.
+ */
+static gearmand_error_t _server_con_fill(gearman_server_con_st *server_con)
+{
+  if (server_con->capacity == 0 or server_con->grab_command == GEARMAN_COMMAND_UNUSED)
+  {
+    return GEARMAND_SUCCESS;
+  }
+
+  while (gearman_server_con_is_full(server_con) == false)
+  {
+    gearman_server_job_st *server_job= gearman_server_job_take(server_con);
+    if (server_job == NULL)
+    {
+      break;
+    }
+
+    gearmand_error_t ret= _server_job_assign(server_con, server_con->grab_command, server_job);
+    if (gearmand_failed(ret))
+    {
+      return ret;
+    }
+  }
+
+  return GEARMAND_SUCCESS;
+}
+
+/**
+ * Cut the next NULL terminated field out of a SUBMIT_JOB_BATCH record.
+ */
+static const char *_server_batch_field(const char *&ptr, const char *end, size_t& size)
+{
+  const char *field= ptr;
+  const char *terminator= static_cast<const char *>(memchr(ptr, 0, size_t(end -ptr)));
+  if (terminator == NULL)
+  {
+    return NULL;
+  }
+
+  size= size_t(terminator -field);
+  ptr= terminator +1;
+
+  return field;
+}
+
+/**
+ * Add every job of a SUBMIT_JOB_BATCH packet and answer with a single
+ * JOB_CREATED_BATCH holding their handles, an empty one for a refused job.
+ */
+static gearmand_error_t _server_submit_batch(gearman_server_con_st *server_con,
+                                             gearmand_packet_st *packet)
+{
+  char strtoul_buffer[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+  snprintf(strtoul_buffer, sizeof(strtoul_buffer), "%.*s", int(packet->arg_size[0]), packet->arg[0]);
+
+  char *endptr;
+  errno= 0;
+  unsigned long count= strtoul(strtoul_buffer, &endptr, 10);
+  if (errno or *endptr or endptr == strtoul_buffer)
+  {
+    return _server_error_packet(GEARMAN_DEFAULT_LOG_PARAM, server_con, GEARMAN_INVALID_ARGUMENT,
+                                gearman_literal_param("SUBMIT_JOB_BATCH takes a number of jobs"));
+  }
+
+  std::vector<gearmand::queue::job_st> jobs;
+  const char *ptr= packet->data;
+  const char *end= packet->data +packet->data_size;
+  while (jobs.size() < count and ptr < end)
+  {
+    gearmand::queue::job_st job;
+    size_t priority_size;
+    size_t data_size_size;
+    const char *priority;
+    const char *data_size;
+    if ((job.function_name= _server_batch_field(ptr, end, job.function_name_size)) == NULL or
+        (job.unique= _server_batch_field(ptr, end, job.unique_size)) == NULL or
+        (priority= _server_batch_field(ptr, end, priority_size)) == NULL or
+        (data_size= _server_batch_field(ptr, end, data_size_size)) == NULL)
+    {
+      break;
+    }
+
+    job.priority= gearman_job_priority_t(strtoul(priority, &endptr, 10));
+    if (endptr == priority or *endptr or job.priority >= GEARMAN_JOB_PRIORITY_MAX)
+    {
+      break;
+    }
+
+    job.data_size= size_t(strtoull(data_size, &endptr, 10));
+    if (endptr == data_size or *endptr or job.data_size > size_t(end -ptr))
+    {
+      break;
+    }
+
+    if (job.function_name_size == 0 or job.unique_size > GEARMAN_UNIQUE_SIZE)
+    {
+      break;
+    }
+
+    job.data= ptr;
+    ptr+= job.data_size;
+    jobs.push_back(job);
+  }
+
+  if (jobs.size() != count or ptr != end)
+  {
+    return _server_error_packet(GEARMAN_DEFAULT_LOG_PARAM, server_con, GEARMAN_INVALID_ARGUMENT,
+                                gearman_literal_param("Malformed SUBMIT_JOB_BATCH packet"));
+  }
+
+  std::vector<gearman_server_job_st *> server_jobs(count);
+  if (count)
+  {
+    gearman_server_job_add_batch(Server, &jobs[0], count, &server_jobs[0], server_con->job_ttl);
+  }
+
+  size_t handles_size= 0;
+  for (size_t x= 0; x < count; ++x)
+  {
+    handles_size+= server_jobs[x] ? strlen(server_jobs[x]->job_handle) +1 : 1;
+  }
+
+  char *handles= static_cast<char *>(malloc(handles_size ? handles_size : 1));
+  if (handles == NULL)
+  {
+    return gearmand_merror("malloc", char, handles_size);
+  }
+
+  char *handle_ptr= handles;
+  for (size_t x= 0; x < count; ++x)
+  {
+    if (server_jobs[x])
+    {
+      size_t handle_length= strlen(server_jobs[x]->job_handle);
+      memcpy(handle_ptr, server_jobs[x]->job_handle, handle_length);
+      handle_ptr+= handle_length;
+    }
+    *handle_ptr++= 0;
+  }
+
+  gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "Received batch of %lu jobs", count);
+
+  int count_length= snprintf(strtoul_buffer, sizeof(strtoul_buffer), "%lu", count);
+  gearmand_error_t ret= gearman_server_io_packet_add(server_con, true, GEARMAN_MAGIC_RESPONSE,
+                                                     GEARMAN_COMMAND_JOB_CREATED_BATCH,
+                                                     strtoul_buffer, size_t(count_length +1),
+                                                     handles, handles_size,
+                                                     NULL);
+  if (gearmand_failed(ret))
+  {
+    free(handles);
+    return gearmand_gerror("gearman_server_io_packet_add", ret);
+  }
+
+  return GEARMAND_SUCCESS;
+}
+
 static gearmand_error_t
 _server_queue_work_data(gearman_server_job_st *server_job,
                         gearmand_packet_st *packet, const gearman_command_t command)
@@ -87,6 +87,39 @@ gearmand_error_t gearman_server_shutdown_graceful(gearman_server_st *server);
 #ifdef __cplusplus
 GEARMAN_API
 gearmand_error_t gearman_server_queue_replay(gearman_server_st& server);
+
+/**
+ * Replay the persistent queue from a background thread instead. Replayed jobs
+ * are added by gearman_server_queue_replay_drain(), which must be called from
+ * the thread that runs commands whenever it is woken up.
+ */
+GEARMAN_API
+gearmand_error_t gearman_server_queue_replay_start(gearman_server_st& server);
+
+GEARMAN_API
+void gearman_server_queue_replay_drain(gearman_server_st& server);
+
+/**
+ * Stop a background replay, call before the server threads go away.
+ */
+GEARMAN_API
+void gearman_server_queue_replay_stop(gearman_server_st& server);
+
+GEARMAN_API
+void gearman_server_queue_replay_free(gearman_server_st& server);
+
+/**
+ * Spill queued payloads to filename once more than budget bytes (0 for no
+ * global budget) are held in memory, see libgearman-server/spill.cc.
+ */
+GEARMAN_API
+gearmand_error_t gearman_server_spill_start(gearman_server_st& server,
+                                            const char *filename,
+                                            uint64_t budget,
+                                            uint32_t prefetch);
+
+GEARMAN_API
+void gearman_server_spill_free(gearman_server_st& server);
 #endif
 
 /**
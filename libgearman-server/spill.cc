@@ -0,0 +1,474 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Gearmand client and server library.
+ *
+ *  Copyright (C) 2013 Data Differential, http://datadifferential.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "gear_config.h"
+
+#include "libgearman-server/common.h"
+#include <libgearman-server/spill.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace gearmand {
+
+Spill::Spill(const std::string& filename_, uint64_t budget_, uint32_t prefetch_) :
+  _filename(filename_),
+  _fd(-1),
+  _budget(budget_),
+  _prefetch(prefetch_),
+  _memory(0),
+  _spilled_jobs(0),
+  _spilled_bytes(0),
+  _end(0),
+  _next_id(0),
+  _write_failed(false),
+  _thread_running(false),
+  _shutdown(false),
+  _reading(0)
+{
+  (void)pthread_mutex_init(&_lock, NULL);
+  (void)pthread_cond_init(&_cond, NULL);
+}
+
+Spill::~Spill()
+{
+  (void)pthread_mutex_lock(&_lock);
+  _shutdown= true;
+  bool join= _thread_running;
+  _thread_running= false;
+  (void)pthread_cond_signal(&_cond);
+  (void)pthread_mutex_unlock(&_lock);
+
+  if (join)
+  {
+    (void)pthread_join(_thread, NULL);
+  }
+
+  for (std::map<uint64_t, void *>::iterator iter= _ready.begin(); iter != _ready.end(); ++iter)
+  {
+    free(iter->second);
+  }
+
+  if (_fd != -1)
+  {
+    (void)close(_fd);
+  }
+
+  (void)pthread_cond_destroy(&_cond);
+  (void)pthread_mutex_destroy(&_lock);
+}
+
+/*
+  The file is unlinked as soon as it is open, spilled payloads are a copy of
+  what the persistent queue holds and must not outlive the server.
+*/
+gearmand_error_t Spill::start()
+{
+  _fd= open(_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (_fd == -1)
+  {
+    return gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, errno, "open(%s)", _filename.c_str());
+  }
+
+  if (unlink(_filename.c_str()) == -1)
+  {
+    gearmand_log_perror_warn(GEARMAN_DEFAULT_LOG_PARAM, errno, "unlink(%s)", _filename.c_str());
+  }
+
+  if (_prefetch)
+  {
+    int pthread_error;
+    if ((pthread_error= pthread_create(&_thread, NULL, _run, this)))
+    {
+      return gearmand_perror(pthread_error, "pthread_create");
+    }
+    _thread_running= true;
+  }
+
+  return GEARMAND_SUCCESS;
+}
+
+bool Spill::over_budget(const gearman_server_function_st *function) const
+{
+  if (_budget and _memory > _budget)
+  {
+    return true;
+  }
+
+  return function->memory_budget and function->memory_size > function->memory_budget;
+}
+
+void Spill::charge(gearman_server_job_st *job)
+{
+  _memory+= job->data_size;
+  job->function->memory_size+= job->data_size;
+}
+
+void Spill::uncharge(gearman_server_job_st *job)
+{
+  _memory-= job->data_size;
+  job->function->memory_size-= job->data_size;
+}
+
+void Spill::release(gearman_server_job_st *job)
+{
+  if (job->spill_id)
+  {
+    forget(job);
+  }
+  else if (job->data)
+  {
+    uncharge(job);
+  }
+}
+
+void Spill::queued(gearman_server_job_st *job)
+{
+  gearman_server_function_st *function= job->function;
+
+  // Lower priorities are taken last, so they go to disk first.
+  for (int priority= GEARMAN_JOB_PRIORITY_LOW; priority >= int(job->priority) and over_budget(function); --priority)
+  {
+    if (function->job_list[priority] == NULL)
+    {
+      continue;
+    }
+
+    gearman_server_job_st *victim= function->job_end[priority];
+    if (victim->data and victim->data_size and victim->worker == NULL)
+    {
+      if (spill(victim) == false)
+      {
+        return;
+      }
+    }
+  }
+}
+
+bool Spill::spill(gearman_server_job_st *job)
+{
+  const char *ptr= (const char *)job->data;
+  size_t length= job->data_size;
+  uint64_t offset= _end;
+
+  while (length)
+  {
+    ssize_t written= pwrite(_fd, ptr, length, off_t(offset));
+    if (written == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      // Keep the payload in memory, and only complain once.
+      if (_write_failed == false)
+      {
+        gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, errno, "pwrite(%s)", _filename.c_str());
+        _write_failed= true;
+      }
+      return false;
+    }
+
+    ptr+= written;
+    offset+= uint64_t(written);
+    length-= size_t(written);
+  }
+  _write_failed= false;
+
+  uncharge(job);
+  free((void *)job->data);
+  job->data= NULL;
+  job->spill_offset= _end;
+  job->spill_id= ++_next_id;
+
+  _end+= job->data_size;
+  _spilled_jobs++;
+  _spilled_bytes+= job->data_size;
+
+  return true;
+}
+
+/*
+  Drop a spilled payload. Space in the file is only reclaimed once nothing
+  is spilled anymore.
+*/
+void Spill::forget(gearman_server_job_st *job)
+{
+  (void)pthread_mutex_lock(&_lock);
+  _requested.erase(job->spill_id);
+  std::map<uint64_t, void *>::iterator iter= _ready.find(job->spill_id);
+  if (iter != _ready.end())
+  {
+    free(iter->second);
+    _ready.erase(iter);
+  }
+  (void)pthread_mutex_unlock(&_lock);
+
+  job->spill_id= 0;
+  _spilled_jobs--;
+  _spilled_bytes-= job->data_size;
+
+  if (_spilled_jobs == 0)
+  {
+    _end= 0;
+    if (ftruncate(_fd, 0) == -1)
+    {
+      gearmand_log_perror_warn(GEARMAN_DEFAULT_LOG_PARAM, errno, "ftruncate(%s)", _filename.c_str());
+    }
+  }
+}
+
+void *Spill::take_prefetched(const gearman_server_job_st *job)
+{
+  void *buffer= NULL;
+
+  (void)pthread_mutex_lock(&_lock);
+  while (_reading == job->spill_id)
+  {
+    (void)pthread_cond_wait(&_cond, &_lock);
+  }
+
+  std::map<uint64_t, void *>::iterator iter= _ready.find(job->spill_id);
+  if (iter != _ready.end())
+  {
+    buffer= iter->second;
+    _ready.erase(iter);
+  }
+  _requested.erase(job->spill_id);
+  (void)pthread_mutex_unlock(&_lock);
+
+  return buffer;
+}
+
+gearmand_error_t Spill::pread_all(void *buffer, size_t size, uint64_t offset)
+{
+  char *ptr= (char *)buffer;
+
+  while (size)
+  {
+    ssize_t read_length= pread(_fd, ptr, size, off_t(offset));
+    if (read_length == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      return GEARMAND_ERRNO;
+    }
+    else if (read_length == 0)
+    {
+      errno= EIO;
+      return GEARMAND_ERRNO;
+    }
+
+    ptr+= read_length;
+    offset+= uint64_t(read_length);
+    size-= size_t(read_length);
+  }
+
+  return GEARMAND_SUCCESS;
+}
+
+gearmand_error_t Spill::load(gearman_server_job_st *job)
+{
+  if (job->spill_id == 0)
+  {
+    return GEARMAND_SUCCESS;
+  }
+
+  void *buffer= take_prefetched(job);
+  if (buffer == NULL)
+  {
+    if ((buffer= malloc(job->data_size)) == NULL)
+    {
+      return gearmand_merror("malloc", char, job->data_size);
+    }
+
+    if (gearmand_failed(pread_all(buffer, job->data_size, job->spill_offset)))
+    {
+      int local_errno= errno;
+      free(buffer);
+      return gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, local_errno, "pread(%s)", _filename.c_str());
+    }
+  }
+
+  forget(job);
+  job->data= buffer;
+  charge(job);
+
+  return GEARMAND_SUCCESS;
+}
+
+gearmand_error_t Spill::read(const gearman_server_job_st *job, void *buffer)
+{
+  assert(job->spill_id);
+  if (gearmand_failed(pread_all(buffer, job->data_size, job->spill_offset)))
+  {
+    return gearmand_log_perror(GEARMAN_DEFAULT_LOG_PARAM, errno, "pread(%s)", _filename.c_str());
+  }
+
+  return GEARMAND_SUCCESS;
+}
+
+void Spill::prefetch(gearman_server_function_st *function)
+{
+  if (_spilled_jobs == 0 or _thread_running == false)
+  {
+    return;
+  }
+
+  bool added= false;
+  uint32_t looked_at= 0;
+
+  (void)pthread_mutex_lock(&_lock);
+  for (int priority= GEARMAN_JOB_PRIORITY_HIGH; priority < GEARMAN_JOB_PRIORITY_MAX and looked_at < _prefetch; ++priority)
+  {
+    for (gearman_server_job_st *job= function->job_list[priority];
+         job != NULL and looked_at < _prefetch;
+         job= job->function_next, looked_at++)
+    {
+      if (job->spill_id and _requested.insert(job->spill_id).second)
+      {
+        request_st request= { job->spill_id, job->spill_offset, job->data_size };
+        _requests.push_back(request);
+        added= true;
+      }
+    }
+  }
+
+  if (added)
+  {
+    (void)pthread_cond_signal(&_cond);
+  }
+  (void)pthread_mutex_unlock(&_lock);
+}
+
+void Spill::stats(uint64_t& memory_bytes, uint64_t& spilled_jobs, uint64_t& spilled_bytes, uint64_t& file_bytes)
+{
+  memory_bytes= _memory;
+  spilled_jobs= _spilled_jobs;
+  spilled_bytes= _spilled_bytes;
+  file_bytes= _end;
+}
+
+void *Spill::_run(void *context)
+{
+  Spill *spill= (Spill *)context;
+
+  (void)gearmand_initialize_thread_logging("[ spill ]");
+
+  (void)pthread_mutex_lock(&spill->_lock);
+  while (spill->_shutdown == false)
+  {
+    if (spill->_requests.empty())
+    {
+      (void)pthread_cond_wait(&spill->_cond, &spill->_lock);
+      continue;
+    }
+
+    request_st request= spill->_requests.front();
+    spill->_requests.pop_front();
+    if (spill->_requested.count(request.id) == 0)
+    {
+      continue;
+    }
+    spill->_reading= request.id;
+    (void)pthread_mutex_unlock(&spill->_lock);
+
+    void *buffer= malloc(request.size);
+    if (buffer and gearmand_failed(spill->pread_all(buffer, request.size, request.offset)))
+    {
+      // load() reads it again and reports the error.
+      free(buffer);
+      buffer= NULL;
+    }
+
+    (void)pthread_mutex_lock(&spill->_lock);
+    if (buffer and spill->_requested.count(request.id))
+    {
+      spill->_ready[request.id]= buffer;
+    }
+    else
+    {
+      free(buffer);
+    }
+    spill->_reading= 0;
+    (void)pthread_cond_broadcast(&spill->_cond);
+  }
+  (void)pthread_mutex_unlock(&spill->_lock);
+
+  return NULL;
+}
+
+} // namespace gearmand
+
+gearmand_error_t gearman_server_spill_start(gearman_server_st& server,
+                                            const char *filename,
+                                            uint64_t budget,
+                                            uint32_t prefetch)
+{
+  assert(server.spill == NULL);
+  server.spill= new (std::nothrow) gearmand::Spill(filename, budget, prefetch);
+  if (server.spill == NULL)
+  {
+    return gearmand_merror("new", gearmand::Spill, 1);
+  }
+
+  gearmand_error_t ret;
+  if (gearmand_failed(ret= server.spill->start()))
+  {
+    delete server.spill;
+    server.spill= NULL;
+  }
+
+  return ret;
+}
+
+void gearman_server_spill_free(gearman_server_st& server)
+{
+  delete server.spill;
+  server.spill= NULL;
+}
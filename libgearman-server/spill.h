@@ -0,0 +1,138 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Gearmand client and server library.
+ *
+ *  Copyright (C) 2013 Data Differential, http://datadifferential.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+  Spilling queued payloads to disk.
+
+  The server keeps track of how many bytes of job payload it holds in memory,
+  in total and per function. When a job is queued while either budget is
+  exceeded, the payload of the job furthest from being taken (the tail of the
+  lowest priority queue of its function) is written to the spill file and
+  freed, leaving only the job structure in memory.
+
+  Payloads are read back when the job is taken. Each take also hands the
+  next few spilled jobs of the function to a prefetch thread, so that their
+  payloads are normally already in memory when a worker asks for them.
+
+  Everything except the prefetch thread runs on the thread that runs
+  commands.
+*/
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+
+#include <pthread.h>
+
+namespace gearmand {
+
+class Spill {
+public:
+  Spill(const std::string& filename, uint64_t budget, uint32_t prefetch);
+
+  ~Spill();
+
+  gearmand_error_t start();
+
+  // The job now holds its payload in memory.
+  void charge(gearman_server_job_st *job);
+
+  // The job is about to be freed.
+  void release(gearman_server_job_st *job);
+
+  // The job was put on its function's queue, spill if over budget.
+  void queued(gearman_server_job_st *job);
+
+  // Bring the payload of a spilled job back into memory.
+  gearmand_error_t load(gearman_server_job_st *job);
+
+  // Copy the payload of a spilled job into buffer, leaving it spilled.
+  gearmand_error_t read(const gearman_server_job_st *job, void *buffer);
+
+  // Start reading the payloads of the next jobs to be taken from function.
+  void prefetch(gearman_server_function_st *function);
+
+  uint64_t budget() const
+  {
+    return _budget;
+  }
+
+  void stats(uint64_t& memory_bytes, uint64_t& spilled_jobs, uint64_t& spilled_bytes, uint64_t& file_bytes);
+
+private:
+  struct request_st {
+    uint64_t id;
+    uint64_t offset;
+    size_t size;
+  };
+
+  static void *_run(void *context);
+  bool over_budget(const gearman_server_function_st *function) const;
+  bool spill(gearman_server_job_st *job);
+  void uncharge(gearman_server_job_st *job);
+  void forget(gearman_server_job_st *job);
+  void *take_prefetched(const gearman_server_job_st *job);
+  gearmand_error_t pread_all(void *buffer, size_t size, uint64_t offset);
+
+  std::string _filename;
+  int _fd;
+  uint64_t _budget;
+  uint32_t _prefetch;
+  uint64_t _memory;
+  uint64_t _spilled_jobs;
+  uint64_t _spilled_bytes;
+  uint64_t _end;
+  uint64_t _next_id;
+  bool _write_failed;
+
+  pthread_t _thread;
+  bool _thread_running;
+  bool _shutdown;
+  uint64_t _reading;
+  std::deque<request_st> _requests;
+  // Ids that were asked for and not yet taken or released.
+  std::set<uint64_t> _requested;
+  std::map<uint64_t, void *> _ready;
+  // Guards everything the prefetch thread touches.
+  pthread_mutex_t _lock;
+  pthread_cond_t _cond;
+};
+
+} // namespace gearmand
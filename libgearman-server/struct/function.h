@@ -43,7 +43,22 @@ struct gearman_server_function_st
   uint32_t job_count;
   uint32_t job_total;
   uint32_t job_running;
+  uint32_t max_running; // 0 means no limit on job_running.
+  uint64_t job_expired; // Jobs dropped because they were not taken before their deadline.
+  /* Seconds before the first retry of a job, doubled for each retry up to the max. */
+  uint32_t retry_backoff;
+  uint32_t retry_backoff_max;
   uint32_t max_queue_size[GEARMAN_JOB_PRIORITY_MAX];
+  /* Payload bytes of all jobs by priority, and the byte version of max_queue_size. */
+  uint64_t job_bytes[GEARMAN_JOB_PRIORITY_MAX];
+  uint64_t max_queue_bytes[GEARMAN_JOB_PRIORITY_MAX];
+  /* Payload bytes held in memory, and the most allowed before spilling. */
+  uint64_t memory_size;
+  uint64_t memory_budget;
+  /* Fair scheduler state, see libgearman-server/scheduler.cc. */
+  uint32_t weight;
+  uint32_t priority_deficit[GEARMAN_JOB_PRIORITY_MAX];
+  gearman_job_priority_t priority_cursor;
   size_t function_name_size;
   gearman_server_function_st *next;
   gearman_server_function_st *prev;
@@ -43,6 +43,7 @@ struct gearmand_thread_st
 {
   bool is_thread_lock;
   bool is_wakeup_event;
+  bool is_tick_event;
   uint32_t count;
   uint32_t dcon_count;
   uint32_t dcon_add_count;
@@ -57,6 +58,7 @@ struct gearmand_thread_st
   gearmand_con_st *free_dcon_list;
   gearman_server_thread_st server_thread;
   struct event wakeup_event;
+  struct event tick_event; // Runs the server once a second when it has no threads of its own.
   pthread_t id;
   pthread_mutex_t lock;
 
@@ -152,6 +152,13 @@ struct gearman_server_con_st
   uint32_t io_packet_count;
   uint32_t proc_packet_count;
   uint32_t worker_count;
+  uint32_t ready_count;
+  uint32_t capacity; // Jobs the worker declared it runs at once, 0 if it did not.
+  uint32_t job_running; // Jobs assigned to the workers of this connection.
+  gearman_command_t grab_command; // Last GRAB_JOB variant, used to push jobs.
+  uint64_t noreply_accepted; // SUBMIT_JOB_NOREPLY jobs queued since the last NOREPLY_ACK_REQ.
+  uint64_t noreply_refused; // SUBMIT_JOB_NOREPLY jobs refused since the last NOREPLY_ACK_REQ.
+  uint32_t job_ttl; // Seconds a job submitted on this connection may wait to be run, 0 for no limit.
   uint32_t client_count;
   gearman_server_thread_st *thread;
   gearman_server_con_st *next;
@@ -168,12 +175,12 @@ struct gearman_server_con_st
   gearman_server_con_st *to_be_freed_next;
   gearman_server_con_st *to_be_freed_prev;
   struct gearman_server_worker_st *worker_list;
+  struct gearman_server_worker_st *ready_list; // Workers with queued jobs, the head is served next.
   struct gearman_server_client_st *client_list;
   const char *_host; // client host
   const char *_port; // client port
   char id[GEARMAND_SERVER_CON_ID_SIZE];
   gearmand::protocol::Context* protocol;
-  struct event *timeout_event;
   SSL* _ssl;
 
   gearman_server_con_st()
@@ -38,6 +38,7 @@
 #pragma once
 
 struct gearman_server_client_st;
+namespace gearmand { class TimerWheel; }
 
 struct gearman_server_job_st
 {
@@ -52,6 +53,8 @@ struct gearman_server_job_st
   uint32_t denominator;
   size_t data_size;
   int64_t when;
+  int64_t queued_at;
+  int64_t deadline; // Epoch second after which the job is dropped, 0 for never.
   gearman_server_job_st *next;
   gearman_server_job_st *prev;
   gearman_server_job_st *unique_next;
@@ -61,8 +64,17 @@ struct gearman_server_job_st
   gearman_server_function_st *function;
   gearman_server_job_st *function_next;
   const void *data;
+  /* Set while the payload lives in the spill file instead of data. */
+  uint64_t spill_id;
+  uint64_t spill_offset;
   gearman_server_client_st *client_list;
   gearman_server_worker_st *worker;
+  /* Set while the worker timeout of the running job is in a timer wheel. */
+  gearmand::TimerWheel *timeout_wheel;
+  gearman_server_job_st **timeout_slot;
+  gearman_server_job_st *timeout_next;
+  gearman_server_job_st *timeout_prev;
+  uint64_t timeout_at;
   char job_handle[GEARMAND_JOB_HANDLE_SIZE];
   size_t unique_length;
   char unique[GEARMAN_MAX_UNIQUE_SIZE];
@@ -60,7 +60,7 @@ enum queue_version_t {
   QUEUE_VERSION_CLASS
 };
 
-namespace gearmand { namespace queue { class Context; } }
+namespace gearmand { namespace queue { class Context; class Replay; } class Scheduler; class Spill; }
 
 struct Queue_st {
   struct queue_st* functions;
@@ -77,6 +77,11 @@ struct gearman_server_st
     */
     bool round_robin;
     bool threaded;
+    /*
+      Replay the persistent queue from a background thread while the server
+      already accepts work, see libgearman-server/replay.cc.
+    */
+    bool background_replay;
   } flags;
   struct State {
     bool queue_startup;
@@ -86,12 +91,16 @@ struct gearman_server_st
   bool proc_wakeup;
   bool proc_shutdown;
   uint32_t job_retries; // Set maximum job retry count.
+  uint32_t retry_backoff; // Default seconds before the first retry of a job, 0 to requeue at once.
+  uint32_t retry_backoff_max; // Default longest delay between retries.
   uint8_t worker_wakeup; // Set maximum number of workers to wake up per job.
   uint32_t job_handle_count;
   uint32_t thread_count;
   uint32_t function_count;
   uint32_t job_count;
   uint32_t unique_count;
+  uint32_t deadline_job_count; // Jobs with a deadline, the expiry sweep is skipped while 0.
+  int64_t expire_sweep_at; // Epoch second of the last expiry sweep.
   uint32_t free_packet_count;
   uint32_t free_job_count;
   uint32_t free_client_count;
@@ -104,10 +113,16 @@ struct gearman_server_st
   gearman_server_worker_st *free_worker_list;
   enum queue_version_t queue_version;
   struct Queue_st queue;
+  gearmand::queue::Replay *replay;
+  gearmand::Spill *spill;
+  gearmand::Scheduler *scheduler;
   pthread_mutex_t proc_lock;
   pthread_cond_t proc_cond;
   pthread_t proc_id;
   char job_handle_prefix[GEARMAND_JOB_HANDLE_SIZE];
+  /* Function that gets jobs out of retries, none if the size is 0. */
+  char dead_letter_function[GEARMAN_FUNCTION_MAX_SIZE];
+  size_t dead_letter_function_size;
   uint32_t hashtable_buckets;
   gearman_server_job_st **job_hash;
   gearman_server_job_st **unique_hash;
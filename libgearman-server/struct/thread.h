@@ -39,6 +39,8 @@
 
 #include <pthread.h>
 
+namespace gearmand { class TimerWheel; }
+
 struct gearman_server_thread_st
 {
   uint32_t con_count;
@@ -61,6 +63,7 @@ struct gearman_server_thread_st
   gearman_server_con_st *to_be_freed_list;
   gearman_server_packet_st *free_packet_list;
   gearmand_connection_list_st gearmand_connection_list_static;
+  gearmand::TimerWheel *timer_wheel; // Worker timeouts of the jobs run by connections of this thread.
   pthread_mutex_t lock;
 
   void run(gearman_server_thread_run_fn *run_fn_, void *run_fn_arg_)
@@ -42,6 +42,7 @@ struct gearman_server_function_st;
 struct gearman_server_worker_st
 {
   uint32_t job_count;
+  uint32_t deficit; // Jobs left in this turn of the fair scheduler.
   long timeout; // struct timeval.tv_sec
   gearman_server_con_st *con;
   gearman_server_worker_st *con_next;
@@ -49,5 +50,7 @@ struct gearman_server_worker_st
   gearman_server_function_st *function;
   gearman_server_worker_st *function_next;
   gearman_server_worker_st *function_prev;
+  gearman_server_worker_st *ready_next; // NULL when not in the ready list of the connection.
+  gearman_server_worker_st *ready_prev;
   gearman_server_job_st *job_list;
 };
@@ -39,11 +39,15 @@
 
 #include "libgearman-server/common.h"
 #include "libgearman-server/log.h"
+#include "libgearman-server/queue.h"
+#include "libgearman-server/replay.h"
+#include "libgearman-server/spill.h"
 #include "libgearman/command.h"
 #include "libgearman/vector.hpp"
 
 #include <cassert>
 #include <cerrno>
+#include <cstdlib>
 #include <cstring>
 
 #define TEXT_SUCCESS "OK\r\n"
@@ -53,6 +57,9 @@
 #define TEXT_ERROR_INTERNAL_ERROR "ERR UNKNOWN_ERROR\r\n"
 #define TEXT_ERROR_UNKNOWN_SHOW_ARGUMENTS "ERR UNKNOWN_SHOW_ARGUMENTS\r\n"
 #define TEXT_ERROR_UNKNOWN_JOB "ERR UNKNOWN_JOB\r\n"
+#define TEXT_ERROR_SNAPSHOT_UNSUPPORTED "ERR SNAPSHOT_UNSUPPORTED The+queue+does+not+store+on+shutdown\r\n"
+#define TEXT_ERROR_SNAPSHOT "ERR SNAPSHOT_FAILED %s\r\n"
+#define TEXT_ERROR_SPILL_DISABLED "ERR SPILL_DISABLED The+server+was+started+without+--spill-file\r\n"
 
 gearmand_error_t server_run_text(gearman_server_con_st *server_con,
                                  gearmand_packet_st *packet)
@@ -162,10 +169,12 @@ gearmand_error_t server_run_text(gearman_server_con_st *server_con,
            function != NULL;
            function= function->next)
       {
-        data.vec_append_printf("%.*s\t%u\t%u\t%u\n",
+        data.vec_append_printf("%.*s\t%u\t%u\t%u\t%" PRIu64 "\t%" PRIu64 "\n",
                                int(function->function_name_size),
                                function->function_name, function->job_total,
-                               function->job_running, function->worker_count);
+                               function->job_running, function->worker_count,
+                               gearman_server_function_job_bytes(function),
+                               function->job_expired);
       }
     }
     data.vec_append_printf(".\n");
@@ -226,6 +235,42 @@ gearmand_error_t server_run_text(gearman_server_con_st *server_con,
 
       data.vec_append_printf(".\n");
     }
+    else if (packet->argc == 2
+             and strcasecmp("replay", (char *)(packet->arg[1])) == 0)
+    {
+      // state, jobs read from the queue, jobs added to the server
+      if (Server->replay)
+      {
+        gearmand::queue::Replay::state_t state;
+        uint64_t read, added;
+        Server->replay->progress(state, read, added);
+        data.vec_append_printf("%s\t%" PRIu64 "\t%" PRIu64 "\n",
+                               gearmand::queue::Replay::strstate(state), read, added);
+      }
+      else
+      {
+        data.vec_append_printf("none\t0\t0\n");
+      }
+
+      data.vec_append_printf(".\n");
+    }
+    else if (packet->argc == 2
+             and strcasecmp("spill", (char *)(packet->arg[1])) == 0)
+    {
+      if (Server->spill)
+      {
+        // payload bytes in memory, budget, jobs spilled, bytes spilled, spill file size
+        uint64_t memory_bytes, spilled_jobs, spilled_bytes, file_bytes;
+        Server->spill->stats(memory_bytes, spilled_jobs, spilled_bytes, file_bytes);
+        data.vec_append_printf("%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\n",
+                               memory_bytes, Server->spill->budget(), spilled_jobs, spilled_bytes, file_bytes);
+        data.vec_append_printf(".\n");
+      }
+      else
+      {
+        data.vec_printf(TEXT_ERROR_SPILL_DISABLED);
+      }
+    }
     else
     {
       data.vec_printf(TEXT_ERROR_UNKNOWN_SHOW_ARGUMENTS);
@@ -356,6 +401,179 @@ gearmand_error_t server_run_text(gearman_server_con_st *server_con,
       data.vec_append_printf(TEXT_SUCCESS);
     }
   }
+  else if (strcasecmp("maxqueuebytes", (char *)(packet->arg[0])) == 0)
+  {
+    if (packet->argc == 1)
+    {
+      data.vec_append_printf(TEXT_ERROR_ARGS, (int)packet->arg_size[0], (char *)(packet->arg[0]));
+    }
+    else
+    {
+      uint64_t max_queue_bytes[GEARMAN_JOB_PRIORITY_MAX];
+
+      for (int priority= 0; priority < GEARMAN_JOB_PRIORITY_MAX; ++priority)
+      {
+        const int argc= priority +2;
+        if (packet->argc > argc)
+        {
+          max_queue_bytes[priority]= strtoull((char *)(packet->arg[argc]), NULL, 10);
+        }
+        else
+        {
+          max_queue_bytes[priority]= 0;
+        }
+      }
+
+      // As with maxqueue, a single limit applies to all priorities.
+      if (packet->argc <= 3)
+      {
+        for (int priority= 1; priority < GEARMAN_JOB_PRIORITY_MAX; ++priority)
+        {
+          max_queue_bytes[priority]= max_queue_bytes[0];
+        }
+      }
+
+      for (uint32_t function_key= 0; function_key < GEARMAND_DEFAULT_HASH_SIZE;
+           function_key++)
+      {
+        for (gearman_server_function_st *function= Server->function_hash[function_key];
+             function != NULL;
+             function= function->next)
+        {
+          if (strlen((char *)(packet->arg[1])) == function->function_name_size &&
+              (memcmp(packet->arg[1], function->function_name, function->function_name_size) == 0))
+          {
+            gearmand_log_debug(GEARMAN_DEFAULT_LOG_PARAM, "Applying queue byte limits to %s", function->function_name);
+            memcpy(function->max_queue_bytes, max_queue_bytes, sizeof(uint64_t) * GEARMAN_JOB_PRIORITY_MAX);
+          }
+        }
+      }
+
+      data.vec_append_printf(TEXT_SUCCESS);
+    }
+  }
+  else if (strcasecmp("weight", (char *)(packet->arg[0])) == 0)
+  {
+    int weight;
+    if (packet->argc != 3 or (weight= atoi((char *)(packet->arg[2]))) < 1)
+    {
+      data.vec_append_printf(TEXT_ERROR_ARGS, (int)packet->arg_size[0], (char *)(packet->arg[0]));
+    }
+    else
+    {
+      gearman_server_function_st *function= gearman_server_function_get(Server,
+                                                                         (char *)(packet->arg[1]),
+                                                                         strlen((char *)(packet->arg[1])));
+      if (function == NULL)
+      {
+        data.vec_printf(TEXT_ERROR_CREATE_FUNCTION, (int)packet->arg_size[1], (char *)(packet->arg[1]));
+      }
+      else
+      {
+        function->weight= uint32_t(weight);
+        data.vec_printf(TEXT_SUCCESS);
+      }
+    }
+  }
+  else if (strcasecmp("maxrunning", (char *)(packet->arg[0])) == 0)
+  {
+    int max_running;
+    if (packet->argc != 3 or (max_running= atoi((char *)(packet->arg[2]))) < 0)
+    {
+      data.vec_append_printf(TEXT_ERROR_ARGS, (int)packet->arg_size[0], (char *)(packet->arg[0]));
+    }
+    else
+    {
+      gearman_server_function_st *function= gearman_server_function_get(Server,
+                                                                         (char *)(packet->arg[1]),
+                                                                         strlen((char *)(packet->arg[1])));
+      if (function == NULL)
+      {
+        data.vec_printf(TEXT_ERROR_CREATE_FUNCTION, (int)packet->arg_size[1], (char *)(packet->arg[1]));
+      }
+      else
+      {
+        const bool at_capacity= gearman_server_function_at_capacity(function);
+        function->max_running= uint32_t(max_running);
+
+        // Raising the limit may let sleeping workers run queued jobs.
+        if (at_capacity and function->job_count and gearman_server_function_at_capacity(function) == false)
+        {
+          gearman_server_function_wakeup(function);
+        }
+        data.vec_printf(TEXT_SUCCESS);
+      }
+    }
+  }
+  else if (strcasecmp("retrybackoff", (char *)(packet->arg[0])) == 0)
+  {
+    int retry_backoff;
+    int retry_backoff_max= int(Server->retry_backoff_max);
+    if ((packet->argc != 3 and packet->argc != 4) or
+        (retry_backoff= atoi((char *)(packet->arg[2]))) < 0 or
+        (packet->argc == 4 and (retry_backoff_max= atoi((char *)(packet->arg[3]))) < 0))
+    {
+      data.vec_append_printf(TEXT_ERROR_ARGS, (int)packet->arg_size[0], (char *)(packet->arg[0]));
+    }
+    else
+    {
+      gearman_server_function_st *function= gearman_server_function_get(Server,
+                                                                         (char *)(packet->arg[1]),
+                                                                         strlen((char *)(packet->arg[1])));
+      if (function == NULL)
+      {
+        data.vec_printf(TEXT_ERROR_CREATE_FUNCTION, (int)packet->arg_size[1], (char *)(packet->arg[1]));
+      }
+      else
+      {
+        function->retry_backoff= uint32_t(retry_backoff);
+        function->retry_backoff_max= uint32_t(retry_backoff_max);
+        data.vec_printf(TEXT_SUCCESS);
+      }
+    }
+  }
+  else if (strcasecmp("memorybudget", (char *)(packet->arg[0])) == 0)
+  {
+    if (packet->argc != 3)
+    {
+      data.vec_append_printf(TEXT_ERROR_ARGS, (int)packet->arg_size[0], (char *)(packet->arg[0]));
+    }
+    else if (Server->spill == NULL)
+    {
+      data.vec_printf(TEXT_ERROR_SPILL_DISABLED);
+    }
+    else
+    {
+      gearman_server_function_st *function= gearman_server_function_get(Server,
+                                                                         (char *)(packet->arg[1]),
+                                                                         strlen((char *)(packet->arg[1])));
+      if (function == NULL)
+      {
+        data.vec_printf(TEXT_ERROR_CREATE_FUNCTION, (int)packet->arg_size[1], (char *)(packet->arg[1]));
+      }
+      else
+      {
+        function->memory_budget= strtoull((char *)(packet->arg[2]), NULL, 10);
+        data.vec_printf(TEXT_SUCCESS);
+      }
+    }
+  }
+  else if (strcasecmp("snapshot", (char *)(packet->arg[0])) == 0)
+  {
+    gearmand_error_t ret= gearman_server_queue_save(*Server);
+    if (ret == GEARMAND_INVALID_ARGUMENT)
+    {
+      data.vec_printf(TEXT_ERROR_SNAPSHOT_UNSUPPORTED);
+    }
+    else if (gearmand_failed(ret))
+    {
+      data.vec_printf(TEXT_ERROR_SNAPSHOT, gearmand_strerror(ret));
+    }
+    else
+    {
+      data.vec_printf(TEXT_SUCCESS);
+    }
+  }
   else if (strcasecmp("getpid", (char *)(packet->arg[0])) == 0)
   {
     data.vec_printf("OK %d\n", (int)getpid());
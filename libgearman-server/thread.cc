@@ -43,6 +43,7 @@
 
 #include "gear_config.h"
 #include "libgearman-server/common.h"
+#include <libgearman-server/timer_wheel.h>
 
 #include <libgearman/command.h>
 #include "libgearman/strcommand.h"
@@ -85,6 +86,11 @@ static gearmand_error_t _proc_thread_start(gearman_server_st *server);
  */
 static void _proc_thread_kill(gearman_server_st *server);
 
+/**
+ * Requeue a job whose worker did not finish it in time.
+ */
+static void _thread_job_timeout(gearman_server_job_st *job);
+
 /** @} */
 
 /*
@@ -125,10 +131,19 @@ bool gearman_server_thread_init(gearman_server_st *server,
   thread->free_packet_list= NULL;
   thread->to_be_freed_list= NULL;
 
+  thread->timer_wheel= new (std::nothrow) gearmand::TimerWheel;
+  if (thread->timer_wheel == NULL)
+  {
+    gearmand_merror("new", gearmand::TimerWheel, 1);
+    return false;
+  }
+
   int error;
   if ((error= pthread_mutex_init(&(thread->lock), NULL)))
   {
     gearmand_perror(error, "pthread_mutex_init");
+    delete thread->timer_wheel;
+    thread->timer_wheel= NULL;
     return false;
   }
 
@@ -168,6 +183,9 @@ void gearman_server_thread_free(gearman_server_thread_st *thread)
     thread->gearman->list_free();
   }
 
+  delete thread->timer_wheel;
+  thread->timer_wheel= NULL;
+
   pthread_mutex_destroy(&(thread->lock));
 
   GEARMAND_LIST__DEL(Server->thread, thread);
@@ -241,6 +259,14 @@ gearman_server_thread_run(gearman_server_thread_st *thread,
     }
   }
 
+  /* Add replayed jobs if we are single threaded. */
+  if (! (Server->flags.threaded))
+  {
+    gearman_server_queue_replay_drain(*Server);
+    gearman_server_job_expire_sweep(Server);
+    gearman_server_thread_timeouts(thread);
+  }
+
   /* Start flushing new outgoing packets if we are single threaded. */
   if (! (Server->flags.threaded))
   {
@@ -279,10 +305,35 @@ gearman_server_thread_run(gearman_server_thread_st *thread,
   return NULL;
 }
 
+void gearman_server_thread_timeouts(gearman_server_thread_st *thread)
+{
+  if (thread->timer_wheel)
+  {
+    thread->timer_wheel->tick(_thread_job_timeout);
+  }
+}
+
 /*
  * Private definitions
  */
 
+static void _thread_job_timeout(gearman_server_job_st *job)
+{
+  /* A timeout has ocurred on a job, re-queue it */
+  gearmand_log_warning(GEARMAN_DEFAULT_LOG_PARAM,
+                       "Worker timeout reached on job, requeueing: %s %s",
+                       job->job_handle, job->unique);
+
+  gearmand_error_t ret= gearman_server_job_queue(job);
+  if (ret != GEARMAND_SUCCESS)
+  {
+    gearmand_log_error(GEARMAN_DEFAULT_LOG_PARAM,
+                       "Failed trying to requeue job after timeout, job lost: %s %s",
+                       job->job_handle, job->unique);
+    gearman_server_job_free(job);
+  }
+}
+
 static gearmand_error_t _thread_packet_read(gearman_server_con_st *con)
 {
   while (1)
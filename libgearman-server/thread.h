@@ -91,6 +91,12 @@ gearmand_con_st *
 gearman_server_thread_run(gearman_server_thread_st *thread,
                           gearmand_error_t *ret_ptr);
 
+/**
+ * Requeue the jobs of a thread whose worker timeout passed.
+ */
+GEARMAN_API
+void gearman_server_thread_timeouts(gearman_server_thread_st *thread);
+
 /** @} */
 
 #ifdef __cplusplus
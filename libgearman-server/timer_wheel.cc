@@ -0,0 +1,180 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Gearmand client and server library.
+ *
+ *  Copyright (C) 2013 Data Differential, http://datadifferential.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "gear_config.h"
+
+#include "libgearman-server/common.h"
+#include <libgearman-server/timer_wheel.h>
+
+#include <cstring>
+#include <ctime>
+
+namespace gearmand {
+
+TimerWheel::TimerWheel() :
+  _now(now()),
+  _size(0)
+{
+  memset(_slots, 0, sizeof(_slots));
+}
+
+uint64_t TimerWheel::now()
+{
+  struct timespec current;
+  clock_gettime(CLOCK_MONOTONIC, &current);
+
+  return uint64_t(current.tv_sec);
+}
+
+void TimerWheel::add(gearman_server_job_st *job, uint64_t milliseconds)
+{
+  remove(job);
+
+  // A timeout never fires early, so round up to whole ticks.
+  uint64_t ticks= (milliseconds +999) / 1000;
+  const uint64_t max_ticks= (uint64_t(1) << (SLOT_BITS * LEVELS)) -1;
+  if (ticks == 0)
+  {
+    ticks= 1;
+  }
+  else if (ticks > max_ticks)
+  {
+    ticks= max_ticks;
+  }
+
+  // Ticks still owed since the last pass count against the timeout too.
+  job->timeout_at= now() +ticks;
+  job->timeout_wheel= this;
+  insert(job);
+  _size++;
+}
+
+void TimerWheel::remove(gearman_server_job_st *job)
+{
+  if (job->timeout_wheel == this)
+  {
+    unlink(job);
+    job->timeout_wheel= NULL;
+    _size--;
+  }
+}
+
+void TimerWheel::tick(expire_fn *expire)
+{
+  const uint64_t current= now();
+  while (_now < current)
+  {
+    _now++;
+
+    uint64_t index= _now;
+    for (uint32_t level= 1; level < LEVELS and (index & SLOT_MASK) == 0; level++)
+    {
+      index>>= SLOT_BITS;
+      cascade(level, index & SLOT_MASK);
+    }
+
+    gearman_server_job_st **slot= &_slots[0][_now & SLOT_MASK];
+    while (*slot)
+    {
+      gearman_server_job_st *job= *slot;
+      unlink(job);
+      job->timeout_wheel= NULL;
+      _size--;
+      expire(job);
+    }
+  }
+}
+
+void TimerWheel::insert(gearman_server_job_st *job)
+{
+  uint64_t ticks= job->timeout_at > _now ? job->timeout_at -_now : 0;
+
+  uint32_t level= 0;
+  while (level < LEVELS -1 and ticks >= (uint64_t(1) << (SLOT_BITS * (level +1))))
+  {
+    level++;
+  }
+
+  // Anything due now goes in the slot this tick is about to run.
+  uint64_t at= ticks ? job->timeout_at : _now;
+  gearman_server_job_st **slot= &_slots[level][(at >> (SLOT_BITS * level)) & SLOT_MASK];
+
+  job->timeout_slot= slot;
+  job->timeout_prev= NULL;
+  job->timeout_next= *slot;
+  if (*slot)
+  {
+    (*slot)->timeout_prev= job;
+  }
+  *slot= job;
+}
+
+void TimerWheel::unlink(gearman_server_job_st *job)
+{
+  if (job->timeout_prev)
+  {
+    job->timeout_prev->timeout_next= job->timeout_next;
+  }
+  else
+  {
+    *job->timeout_slot= job->timeout_next;
+  }
+
+  if (job->timeout_next)
+  {
+    job->timeout_next->timeout_prev= job->timeout_prev;
+  }
+
+  job->timeout_next= NULL;
+  job->timeout_prev= NULL;
+  job->timeout_slot= NULL;
+}
+
+void TimerWheel::cascade(uint32_t level, uint64_t slot)
+{
+  gearman_server_job_st *job= _slots[level][slot];
+  _slots[level][slot]= NULL;
+
+  while (job)
+  {
+    gearman_server_job_st *next= job->timeout_next;
+    insert(job);
+    job= next;
+  }
+}
+
+} // namespace gearmand
@@ -0,0 +1,96 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Gearmand client and server library.
+ *
+ *  Copyright (C) 2013 Data Differential, http://datadifferential.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+  Worker timeouts of running jobs.
+
+  Every server thread owns a hierarchical timer wheel of one second ticks:
+  four levels of 64 slots, so the first level covers the next minute and
+  each level above covers 64 times as much as the one below. A timeout is
+  put in the slot of the lowest level that reaches it, and whenever a level
+  wraps around, the next slot of the level above is moved down. The links
+  live in gearman_server_job_st, so adding and removing a timeout never
+  allocates.
+
+  Like the jobs themselves, the wheels are only touched on the thread that
+  runs commands, which ticks them once per pass over its queue.
+*/
+
+#pragma once
+
+struct gearman_server_job_st;
+
+namespace gearmand {
+
+class TimerWheel {
+public:
+  typedef void (expire_fn)(gearman_server_job_st *job);
+
+  TimerWheel();
+
+  // Time the job out the given number of milliseconds from now, replacing
+  // any timeout it already has.
+  void add(gearman_server_job_st *job, uint64_t milliseconds);
+
+  void remove(gearman_server_job_st *job);
+
+  // Move the wheel up to the current time, calling expire for every job
+  // whose timeout passed.
+  void tick(expire_fn *expire);
+
+  size_t size() const
+  {
+    return _size;
+  }
+
+private:
+  static const uint32_t LEVELS= 4;
+  static const uint32_t SLOT_BITS= 6;
+  static const uint32_t SLOTS= 1 << SLOT_BITS;
+  static const uint64_t SLOT_MASK= SLOTS -1;
+
+  static uint64_t now();
+  void insert(gearman_server_job_st *job);
+  void unlink(gearman_server_job_st *job);
+  void cascade(uint32_t level, uint64_t slot);
+
+  uint64_t _now;
+  size_t _size;
+  gearman_server_job_st *_slots[LEVELS][SLOTS];
+};
+
+} // namespace gearmand
@@ -46,6 +46,65 @@
 
 #include <memory>
 
+/*
+  The ready list of a connection is circular, new workers go in at the tail
+  (just before the head) so they are served last.
+*/
+static void _worker_ready_add(gearman_server_worker_st *worker)
+{
+  gearman_server_con_st *con= worker->con;
+
+  if (worker->ready_next)
+  {
+    return;
+  }
+
+  if (con->ready_list == NULL)
+  {
+    con->ready_list= worker;
+    worker->ready_next= worker;
+    worker->ready_prev= worker;
+  }
+  else
+  {
+    worker->ready_next= con->ready_list;
+    worker->ready_prev= con->ready_list->ready_prev;
+    worker->ready_next->ready_prev= worker;
+    worker->ready_prev->ready_next= worker;
+  }
+  con->ready_count++;
+}
+
+static void _worker_ready_del(gearman_server_worker_st *worker)
+{
+  gearman_server_con_st *con= worker->con;
+
+  if (worker->ready_next == NULL)
+  {
+    return;
+  }
+
+  if (worker == worker->ready_next)
+  {
+    con->ready_list= NULL;
+  }
+  else
+  {
+    worker->ready_next->ready_prev= worker->ready_prev;
+    worker->ready_prev->ready_next= worker->ready_next;
+
+    if (worker == con->ready_list)
+    {
+      con->ready_list= worker->ready_next;
+    }
+  }
+  con->ready_count--;
+
+  worker->ready_next= NULL;
+  worker->ready_prev= NULL;
+  worker->deficit= 0;
+}
+
 static gearman_server_worker_st* gearman_server_worker_create(gearman_server_con_st *con, gearman_server_function_st *function)
 {
   gearman_server_worker_st *worker;
@@ -66,6 +125,7 @@ static gearman_server_worker_st* gearman_server_worker_create(gearman_server_con
   }
 
   worker->job_count= 0;
+  worker->deficit= 0;
   worker->timeout= -1;
   worker->con= con;
   GEARMAND_LIST_ADD(con->worker, worker, con_);
@@ -89,6 +149,15 @@ static gearman_server_worker_st* gearman_server_worker_create(gearman_server_con
 
   worker->job_list= NULL;
 
+  worker->ready_next= NULL;
+  worker->ready_prev= NULL;
+  if (function->job_count)
+  {
+    // Like the worker list, a new registration is served first.
+    _worker_ready_add(worker);
+    con->ready_list= worker;
+  }
+
   return worker;
 }
 
@@ -130,6 +199,7 @@ void gearman_server_worker_free(gearman_server_worker_st *worker)
     }
   }
 
+  _worker_ready_del(worker);
   GEARMAND_LIST_DEL(worker->con->worker, worker, con_);
 
   if (worker == worker->function_next)
@@ -158,3 +228,29 @@ void gearman_server_worker_free(gearman_server_worker_st *worker)
     delete worker;
   }
 }
+
+void gearman_server_worker_ready_function(gearman_server_function_st *function)
+{
+  gearman_server_worker_st *worker= function->worker_list;
+  if (worker)
+  {
+    do
+    {
+      _worker_ready_add(worker);
+      worker= worker->function_next;
+    } while (worker != function->worker_list);
+  }
+}
+
+void gearman_server_worker_idle_function(gearman_server_function_st *function)
+{
+  gearman_server_worker_st *worker= function->worker_list;
+  if (worker)
+  {
+    do
+    {
+      _worker_ready_del(worker);
+      worker= worker->function_next;
+    } while (worker != function->worker_list);
+  }
+}
@@ -72,6 +72,18 @@ gearman_server_worker_add(gearman_server_con_st *con, const char *function_name,
 GEARMAN_API
 void gearman_server_worker_free(gearman_server_worker_st *worker);
 
+/**
+ * Add all workers of a function to the ready lists of their connections,
+ * called when the function gets its first queued job.
+ */
+void gearman_server_worker_ready_function(gearman_server_function_st *function);
+
+/**
+ * Remove all workers of a function from the ready lists of their
+ * connections, called when the last queued job of the function is taken.
+ */
+void gearman_server_worker_idle_function(gearman_server_function_st *function);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -110,6 +110,13 @@ namespace {
     case GEARMAN_COMMAND_WORK_WARNING:
     case GEARMAN_COMMAND_GET_STATUS_UNIQUE:
     case GEARMAN_COMMAND_STATUS_RES_UNIQUE:
+    case GEARMAN_COMMAND_GRAB_JOB_MULTI:
+    case GEARMAN_COMMAND_JOB_ASSIGN_MULTI:
+    case GEARMAN_COMMAND_SUBMIT_JOB_BATCH:
+    case GEARMAN_COMMAND_JOB_CREATED_BATCH:
+    case GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY:
+    case GEARMAN_COMMAND_NOREPLY_ACK_REQ:
+    case GEARMAN_COMMAND_NOREPLY_ACK_RES:
       assert(0);
       break;
     }
@@ -317,6 +324,13 @@ gearman_task_st *add_task(Client& client,
   case GEARMAN_COMMAND_WORK_WARNING:
   case GEARMAN_COMMAND_GET_STATUS_UNIQUE:
   case GEARMAN_COMMAND_STATUS_RES_UNIQUE:
+  case GEARMAN_COMMAND_GRAB_JOB_MULTI:
+  case GEARMAN_COMMAND_JOB_ASSIGN_MULTI:
+  case GEARMAN_COMMAND_SUBMIT_JOB_BATCH:
+  case GEARMAN_COMMAND_JOB_CREATED_BATCH:
+  case GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY:
+  case GEARMAN_COMMAND_NOREPLY_ACK_REQ:
+  case GEARMAN_COMMAND_NOREPLY_ACK_RES:
     rc= GEARMAN_INVALID_ARGUMENT;
     assert(rc != GEARMAN_INVALID_ARGUMENT);
     break;
@@ -141,3 +141,75 @@ gearman_return_t OptionCheck::success(gearman_connection_st* con)
 
   return GEARMAN_SUCCESS;
 }
+
+gearman_return_t BatchCheck::success(gearman_connection_st* con)
+{
+  if (con->_packet.command == GEARMAN_COMMAND_ERROR)
+  {
+    if (con->_packet.argc)
+    {
+      gearman_return_t maybe_server_error= string2return_code(static_cast<char *>(con->_packet.arg[0]), int(con->_packet.arg_size[0]));
+      if (maybe_server_error == GEARMAN_MAX_RETURN)
+      {
+        maybe_server_error= GEARMAN_SERVER_ERROR;
+      }
+
+      return gearman_universal_set_error(_universal, maybe_server_error, GEARMAN_AT, "%s:%s %.*s:%.*s",
+                                         con->host(), con->service(),
+                                         con->_packet.arg_size[0], con->_packet.arg[0],
+                                         con->_packet.arg_size[1], con->_packet.arg[1]
+                                        );
+    }
+
+    return gearman_universal_set_error(_universal, GEARMAN_SERVER_ERROR, GEARMAN_AT, "%s:%s lacks support for SUBMIT_JOB_BATCH",
+                                       con->host(), con->service()
+                                      );
+  }
+
+  if (con->_packet.command != GEARMAN_COMMAND_JOB_CREATED_BATCH)
+  {
+    return gearman_error(_universal, GEARMAN_INVALID_COMMAND, "Wrong command sent in response to SUBMIT_JOB_BATCH request");
+  }
+
+  const char *ptr= con->_packet.value();
+  const char *end= ptr +con->_packet.size();
+  for (size_t x= 0; x < _count; ++x)
+  {
+    const char *handle_end= ptr < end ? static_cast<const char *>(memchr(ptr, 0, size_t(end -ptr))) : NULL;
+    if (handle_end == NULL or size_t(handle_end -ptr) >= GEARMAN_JOB_HANDLE_SIZE)
+    {
+      return gearman_universal_set_error(_universal, GEARMAN_INVALID_PACKET, GEARMAN_AT, "%s:%s sent %u job handles, expected %u",
+                                         con->host(), con->service(), uint32_t(x), uint32_t(_count));
+    }
+
+    memcpy(_jobs[x].job_handle, ptr, size_t(handle_end -ptr) +1);
+    _jobs[x].ret= handle_end == ptr ? GEARMAN_JOB_QUEUE_FULL : GEARMAN_SUCCESS;
+    ptr= handle_end +1;
+  }
+
+  return GEARMAN_SUCCESS;
+}
+
+gearman_return_t NoreplyAckCheck::success(gearman_connection_st* con)
+{
+  if (con->_packet.command == GEARMAN_COMMAND_ERROR)
+  {
+    return gearman_universal_set_error(_universal, GEARMAN_SERVER_ERROR, GEARMAN_AT, "%s:%s lacks support for NOREPLY_ACK_REQ",
+                                       con->host(), con->service()
+                                      );
+  }
+
+  if (con->_packet.command != GEARMAN_COMMAND_NOREPLY_ACK_RES or con->_packet.argc != 2)
+  {
+    return gearman_error(_universal, GEARMAN_INVALID_COMMAND, "Wrong command sent in response to NOREPLY_ACK_REQ request");
+  }
+
+  char buffer[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+  snprintf(buffer, sizeof(buffer), "%.*s", int(con->_packet.arg_size[0]), con->_packet.arg[0]);
+  _accepted+= strtoull(buffer, NULL, 10);
+
+  snprintf(buffer, sizeof(buffer), "%.*s", int(con->_packet.arg_size[1]), con->_packet.arg[1]);
+  _refused+= strtoull(buffer, NULL, 10);
+
+  return GEARMAN_SUCCESS;
+}
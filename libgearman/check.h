@@ -90,3 +90,46 @@ private:
   gearman_universal_st& _universal;
 };
 
+class BatchCheck : public Check {
+public:
+  BatchCheck(gearman_universal_st& universal_, gearman_batch_job_t *jobs_, const size_t count_):
+    _universal(universal_),
+    _jobs(jobs_),
+    _count(count_)
+  {
+  }
+
+  gearman_return_t success(gearman_connection_st* con);
+
+private:
+  gearman_universal_st& _universal;
+  gearman_batch_job_t *_jobs;
+  const size_t _count;
+};
+
+class NoreplyAckCheck : public Check {
+public:
+  NoreplyAckCheck(gearman_universal_st& universal_):
+    _universal(universal_),
+    _accepted(0),
+    _refused(0)
+  {
+  }
+
+  gearman_return_t success(gearman_connection_st* con);
+
+  uint64_t accepted() const
+  {
+    return _accepted;
+  }
+
+  uint64_t refused() const
+  {
+    return _refused;
+  }
+
+private:
+  gearman_universal_st& _universal;
+  uint64_t _accepted;
+  uint64_t _refused;
+};
@@ -43,9 +43,11 @@
 
 #include "libgearman/assert.hpp"
 #include "libgearman/interface/push.hpp"
+#include "libgearman/uuid.hpp"
 
 #include <arpa/inet.h>
 #include <cerrno>
+#include <cinttypes>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -819,6 +821,129 @@ gearman_return_t gearman_client_do_low_background(gearman_client_st *client_shel
                                job_handle);
 }
 
+gearman_return_t gearman_client_do_background_batch(gearman_client_st *client_shell,
+                                                    gearman_batch_job_t *jobs,
+                                                    size_t count)
+{
+  if (client_shell == NULL or client_shell->impl() == NULL)
+  {
+    return GEARMAN_INVALID_ARGUMENT;
+  }
+
+  Client* client= client_shell->impl();
+  client->universal.reset_error();
+
+  if (jobs == NULL or count == 0)
+  {
+    return gearman_error(client->universal, GEARMAN_INVALID_ARGUMENT, "no jobs were provided");
+  }
+
+  for (size_t x= 0; x < count; ++x)
+  {
+    jobs[x].ret= GEARMAN_UNKNOWN_STATE;
+    jobs[x].job_handle[0]= 0;
+
+    if (jobs[x].function_name == NULL or jobs[x].function_name[0] == 0)
+    {
+      return gearman_error(client->universal, GEARMAN_INVALID_ARGUMENT, "function argument was empty");
+    }
+
+    if (jobs[x].unique and strlen(jobs[x].unique) > GEARMAN_MAX_UNIQUE_SIZE)
+    {
+      return gearman_error(client->universal, GEARMAN_INVALID_ARGUMENT, "unique name longer then GEARMAN_MAX_UNIQUE_SIZE");
+    }
+
+    if (uint32_t(jobs[x].priority) >= uint32_t(GEARMAN_JOB_PRIORITY_MAX))
+    {
+      return gearman_error(client->universal, GEARMAN_INVALID_ARGUMENT, "invalid priority");
+    }
+
+    if (jobs[x].workload == NULL and jobs[x].workload_size)
+    {
+      return gearman_error(client->universal, GEARMAN_INVALID_ARGUMENT, "workload was NULL but workload_size was not zero");
+    }
+  }
+
+  return gearman_submit_batch(client->universal, jobs, count);
+}
+
+gearman_return_t gearman_client_do_background_noreply(gearman_client_st *client_shell,
+                                                      const char *function_name,
+                                                      const char *unique,
+                                                      const void *workload_str,
+                                                      size_t workload_size)
+{
+  if (client_shell == NULL or client_shell->impl() == NULL)
+  {
+    return GEARMAN_INVALID_ARGUMENT;
+  }
+
+  Client* client= client_shell->impl();
+  client->universal.reset_error();
+
+  gearman_string_t function= { gearman_string_param_cstr(function_name) };
+  if (gearman_size(function) == 0)
+  {
+    return gearman_error(client->universal, GEARMAN_INVALID_ARGUMENT, "function argument was empty");
+  }
+
+  char unique_buffer[GEARMAN_MAX_UNIQUE_SIZE +1];
+  size_t unique_length;
+  if (unique)
+  {
+    unique_length= strlen(unique);
+    if (unique_length > GEARMAN_MAX_UNIQUE_SIZE)
+    {
+      return gearman_error(client->universal, GEARMAN_INVALID_ARGUMENT, "unique name longer then GEARMAN_MAX_UNIQUE_SIZE");
+    }
+    memcpy(unique_buffer, unique, unique_length +1);
+  }
+  else
+  {
+    safe_uuid_generate(unique_buffer, unique_length);
+  }
+
+  gearman_unique_t local_unique= gearman_unique_make(unique_buffer, unique_length);
+  gearman_string_t workload= { static_cast<const char*>(workload_str), workload_size };
+
+  return gearman_submit_noreply(client->universal, local_unique, function, workload);
+}
+
+gearman_return_t gearman_client_noreply_ack(gearman_client_st *client_shell,
+                                            uint64_t *accepted,
+                                            uint64_t *refused)
+{
+  if (client_shell == NULL or client_shell->impl() == NULL)
+  {
+    return GEARMAN_INVALID_ARGUMENT;
+  }
+
+  Client* client= client_shell->impl();
+  client->universal.reset_error();
+
+  uint64_t accepted_count;
+  uint64_t refused_count;
+  gearman_return_t ret= gearman_noreply_ack(client->universal, accepted_count, refused_count);
+
+  if (accepted)
+  {
+    *accepted= accepted_count;
+  }
+
+  if (refused)
+  {
+    *refused= refused_count;
+  }
+
+  if (gearman_success(ret) and refused_count)
+  {
+    return gearman_universal_set_error(client->universal, GEARMAN_JOB_QUEUE_FULL, GEARMAN_AT,
+                                       "%" PRIu64 " jobs were refused", refused_count);
+  }
+
+  return ret;
+}
+
 gearman_status_t gearman_client_unique_status(gearman_client_st *client_shell,
                                               const char *unique, size_t unique_length)
 {
@@ -65,6 +65,8 @@ struct Worker
   enum gearman_worker_universal_t work_state;
   uint32_t function_count;
   uint32_t job_count;
+  uint32_t grab_batch; // Jobs asked for by each GRAB_JOB_MULTI, 0 when not batching.
+  uint32_t grab_pending; // Jobs of the last JOB_ASSIGN_MULTI not read yet.
   size_t work_result_size;
   void *context;
   gearman_connection_st *con;
@@ -84,6 +86,8 @@ struct Worker
     work_state(GEARMAN_WORKER_WORK_UNIVERSAL_GRAB_JOB),
     function_count(0),
     job_count(0),
+    grab_batch(0),
+    grab_pending(0),
     work_result_size(0),
     context(NULL),
     con(NULL),
@@ -38,6 +38,7 @@
 #include "gear_config.h"
 #include <libgearman/common.h>
 #include "libgearman/vector.h"
+#include "libgearman/uuid.hpp"
 
 #include <cstdio>
 #include <cstring>
@@ -160,6 +161,60 @@ gearman_return_t submit_epoch(gearman_universal_st& universal,
                                     4);
 }
 
+gearman_return_t submit_batch(gearman_universal_st& universal,
+                              gearman_packet_st& message,
+                              const gearman_batch_job_t *jobs,
+                              const size_t count)
+{
+  gearman_vector_st records;
+
+  for (size_t x= 0; x < count; ++x)
+  {
+    char unique_buffer[GEARMAN_MAX_UNIQUE_SIZE +1];
+    size_t unique_length;
+    if (jobs[x].unique)
+    {
+      unique_length= strlen(jobs[x].unique);
+      memcpy(unique_buffer, jobs[x].unique, unique_length +1);
+    }
+    else
+    {
+      safe_uuid_generate(unique_buffer, unique_length);
+    }
+
+    if ((universal._namespace and
+         records.append(gearman_string_value(universal._namespace), gearman_string_length(universal._namespace)) == false) or
+        records.append(jobs[x].function_name, strlen(jobs[x].function_name) +1) == false or
+        records.append(unique_buffer, unique_length +1) == false or
+        records.vec_append_printf("%u", uint32_t(jobs[x].priority)) == -1 or
+        records.append_character(0) == false or
+        records.vec_append_printf("%lu", static_cast<unsigned long>(jobs[x].workload_size)) == -1 or
+        records.append_character(0) == false or
+        records.append(static_cast<const char*>(jobs[x].workload), jobs[x].workload_size) == false)
+    {
+      return gearman_error(universal, GEARMAN_MEMORY_ALLOCATION_FAILURE, "could not build SUBMIT_JOB_BATCH");
+    }
+  }
+
+  char count_buffer[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+  int count_length= snprintf(count_buffer, sizeof(count_buffer), "%lu", static_cast<unsigned long>(count));
+
+  const void *args[2];
+  size_t args_size[2];
+
+  args[0]= count_buffer;
+  args_size[0]= size_t(count_length) +1;
+
+  args[1]= records.value();
+  args_size[1]= records.size();
+
+  return gearman_packet_create_args(universal, message,
+                                    GEARMAN_MAGIC_REQUEST,
+                                    GEARMAN_COMMAND_SUBMIT_JOB_BATCH,
+                                    args, args_size,
+                                    2);
+}
+
 } // namespace protocol
 } // namespace libgearman
 
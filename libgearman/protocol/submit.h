@@ -62,5 +62,10 @@ gearman_return_t submit_epoch(gearman_universal_st&,
                               const gearman_string_t &workload,
                               time_t when);
 
+gearman_return_t submit_batch(gearman_universal_st&,
+                              gearman_packet_st& message,
+                              const gearman_batch_job_t *jobs,
+                              const size_t count);
+
 } // namespace protocol
 } // namespace libgearman
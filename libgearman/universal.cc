@@ -551,6 +551,41 @@ gearman_return_t gearman_set_identifier(gearman_universal_st& universal,
   return GEARMAN_SUCCESS;
 }
 
+static gearman_return_t connection_exchange(gearman_universal_st& universal,
+                                            gearman_connection_st *con,
+                                            const gearman_packet_st& message,
+                                            Check& check)
+{
+  gearman_return_t ret= con->send_packet(message, true);
+  if (gearman_failed(ret))
+  {
+    return ret;
+  }
+
+  con->options.packet_in_use= true;
+  gearman_packet_st *packet_ptr= con->receiving(con->_packet, ret, true);
+  if (packet_ptr == NULL)
+  {
+    if (ret != GEARMAN_NOT_CONNECTED and ret != GEARMAN_LOST_CONNECTION)
+    {
+      assert(&con->_packet == universal.packet_list);
+    }
+    con->options.packet_in_use= false;
+    return ret;
+  }
+
+  assert(packet_ptr == &con->_packet);
+  if (gearman_success(ret))
+  {
+    ret= check.success(con);
+  }
+
+  con->free_private_packet();
+  con->reset_recv_packet();
+
+  return ret;
+}
+
 static gearman_return_t connection_loop(gearman_universal_st& universal,
                                         const gearman_packet_st& message,
                                         Check& check)
@@ -559,53 +594,32 @@ static gearman_return_t connection_loop(gearman_universal_st& universal,
 
   for (gearman_connection_st *con= universal.con_list; con; con= con->next_connection())
   {
-    ret= con->send_packet(message, true);
-    if (gearman_failed(ret))
-    {
-#if 0
-      assert_msg(con->universal.error.rc != GEARMAN_SUCCESS, "Programmer error, error returned but not recorded");
-#endif
-      break;
-    }
-
-    con->options.packet_in_use= true;
-    gearman_packet_st *packet_ptr= con->receiving(con->_packet, ret, true);
-    if (packet_ptr == NULL)
+    if (gearman_failed(ret= connection_exchange(universal, con, message, check)))
     {
-      if (ret != GEARMAN_NOT_CONNECTED and ret != GEARMAN_LOST_CONNECTION)
-      {
-        assert(&con->_packet == universal.packet_list);
-      }
-      con->options.packet_in_use= false;
       break;
     }
+  }
 
-    assert(packet_ptr == &con->_packet);
-    if (gearman_failed(ret))
-    {
-#if 0
-      assert_msg(con->universal.error.rc != GEARMAN_SUCCESS, "Programmer error, error returned but not recorded");
-#endif
-      con->free_private_packet();
-      con->reset_recv_packet();
+  return ret;
+}
 
-      break;
-    }
-    assert(packet_ptr);
+/*
+  Like connection_loop(), but the request is only sent until one server has
+  answered it. Servers that cannot be reached are skipped.
+*/
+static gearman_return_t connection_first(gearman_universal_st& universal,
+                                         const gearman_packet_st& message,
+                                         Check& check)
+{
+  gearman_return_t ret= GEARMAN_NO_SERVERS;
 
-    if (gearman_failed(ret= check.success(con)))
+  for (gearman_connection_st *con= universal.con_list; con; con= con->next_connection())
+  {
+    ret= connection_exchange(universal, con, message, check);
+    if (ret != GEARMAN_COULD_NOT_CONNECT and ret != GEARMAN_LOST_CONNECTION and ret != GEARMAN_NOT_CONNECTED)
     {
-#if 0
-      assert_msg(con->universal.error.rc != GEARMAN_SUCCESS, "Programmer error, error returned but not recorded");
-#endif
-      con->free_private_packet();
-      con->reset_recv_packet();
-
       break;
     }
-
-    con->reset_recv_packet();
-    con->free_private_packet();
   }
 
   return ret;
@@ -667,6 +681,102 @@ gearman_return_t gearman_echo(gearman_universal_st& universal,
   return ret;
 }
 
+gearman_return_t gearman_submit_batch(gearman_universal_st& universal,
+                                      gearman_batch_job_t *jobs,
+                                      size_t count)
+{
+  if (universal.has_connections() == false)
+  {
+    return gearman_universal_set_error(universal, GEARMAN_NO_SERVERS, GEARMAN_AT, "no servers provided");
+  }
+
+  gearman_packet_st message;
+  gearman_return_t ret= libgearman::protocol::submit_batch(universal, message, jobs, count);
+  if (gearman_success(ret))
+  {
+    PUSH_BLOCKING(universal);
+
+    BatchCheck check(universal, jobs, count);
+    ret= connection_first(universal, message, check);
+  }
+  else
+  {
+    return universal.error_code();
+  }
+
+  gearman_packet_free(&message);
+
+  return ret;
+}
+
+gearman_return_t gearman_submit_noreply(gearman_universal_st& universal,
+                                        const gearman_unique_t& unique,
+                                        const gearman_string_t& function,
+                                        const gearman_string_t& workload)
+{
+  if (universal.has_connections() == false)
+  {
+    return gearman_universal_set_error(universal, GEARMAN_NO_SERVERS, GEARMAN_AT, "no servers provided");
+  }
+
+  gearman_packet_st message;
+  gearman_return_t ret= libgearman::protocol::submit_background(universal, message, unique,
+                                                                 GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY,
+                                                                 function, workload);
+  if (gearman_failed(ret))
+  {
+    return universal.error_code();
+  }
+
+  PUSH_BLOCKING(universal);
+
+  ret= GEARMAN_NO_SERVERS;
+  for (gearman_connection_st *con= universal.con_list; con; con= con->next_connection())
+  {
+    ret= con->send_packet(message, true);
+    if (ret != GEARMAN_COULD_NOT_CONNECT and ret != GEARMAN_LOST_CONNECTION and ret != GEARMAN_NOT_CONNECTED)
+    {
+      break;
+    }
+  }
+
+  gearman_packet_free(&message);
+
+  return ret;
+}
+
+gearman_return_t gearman_noreply_ack(gearman_universal_st& universal, uint64_t& accepted, uint64_t& refused)
+{
+  accepted= 0;
+  refused= 0;
+
+  if (universal.has_connections() == false)
+  {
+    return gearman_universal_set_error(universal, GEARMAN_NO_SERVERS, GEARMAN_AT, "no servers provided");
+  }
+
+  gearman_packet_st message;
+  gearman_return_t ret= gearman_packet_create_args(universal, message,
+                                                   GEARMAN_MAGIC_REQUEST,
+                                                   GEARMAN_COMMAND_NOREPLY_ACK_REQ,
+                                                   NULL, NULL, 0);
+  if (gearman_failed(ret))
+  {
+    return universal.error_code();
+  }
+
+  PUSH_BLOCKING(universal);
+
+  NoreplyAckCheck check(universal);
+  ret= connection_loop(universal, message, check);
+  accepted= check.accepted();
+  refused= check.refused();
+
+  gearman_packet_free(&message);
+
+  return ret;
+}
+
 gearman_return_t cancel_job(gearman_universal_st& universal,
                             gearman_job_handle_t job_handle)
 {
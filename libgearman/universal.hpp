@@ -40,6 +40,8 @@
 
 #include "libgearman/interface/client.hpp"
 
+struct gearman_unique_t;
+
 // Get next connection that is ready for I/O.
 gearman_connection_st *gearman_ready(gearman_universal_st&);
 
@@ -86,6 +88,18 @@ void gearman_free_all_cons(gearman_universal_st&);
 // Test echo with all connections.
 gearman_return_t gearman_echo(gearman_universal_st&, const void *workload, size_t workload_size);
 
+// Submit a batch of background jobs to the first server that answers.
+gearman_return_t gearman_submit_batch(gearman_universal_st&, gearman_batch_job_t *jobs, size_t count);
+
+// Send a background job to the first server that takes it, without waiting for a reply.
+gearman_return_t gearman_submit_noreply(gearman_universal_st&,
+                                        const gearman_unique_t& unique,
+                                        const gearman_string_t& function,
+                                        const gearman_string_t& workload);
+
+// Collect the SUBMIT_JOB_NOREPLY counters of all servers.
+gearman_return_t gearman_noreply_ack(gearman_universal_st&, uint64_t& accepted, uint64_t& refused);
+
 /**
  * Wait for I/O on connections.
  *
@@ -165,6 +165,12 @@ gearman_worker_st *gearman_worker_clone(gearman_worker_st *worker_shell,
       return NULL;
     }
 
+    if (source->grab_batch and gearman_failed(gearman_worker_set_grab_batch(worker_shell, source->grab_batch)))
+    {
+      gearman_worker_free(worker_shell);
+      return NULL;
+    }
+
     for (struct _worker_function_st* function= source->function_list;
          function;
          function= function->next)
@@ -318,21 +324,28 @@ void gearman_worker_add_options(gearman_worker_st *worker_shell,
       worker->options.non_blocking= true;
     }
 
+    // A batched grab always asks for JOB_ASSIGN_ALL, so leave its packet be.
     if (options & GEARMAN_WORKER_GRAB_UNIQ)
     {
-      worker->grab_job.command= GEARMAN_COMMAND_GRAB_JOB_UNIQ;
-      gearman_return_t rc= gearman_packet_pack_header(&(worker->grab_job));
-      (void)(rc);
-      assert(gearman_success(rc));
+      if (worker->grab_batch == 0)
+      {
+        worker->grab_job.command= GEARMAN_COMMAND_GRAB_JOB_UNIQ;
+        gearman_return_t rc= gearman_packet_pack_header(&(worker->grab_job));
+        (void)(rc);
+        assert(gearman_success(rc));
+      }
       worker->options.grab_uniq= true;
     }
 
     if (options & GEARMAN_WORKER_GRAB_ALL)
     {
-      worker->grab_job.command= GEARMAN_COMMAND_GRAB_JOB_ALL;
-      gearman_return_t rc= gearman_packet_pack_header(&(worker->grab_job));
-      (void)(rc);
-      assert(gearman_success(rc));
+      if (worker->grab_batch == 0)
+      {
+        worker->grab_job.command= GEARMAN_COMMAND_GRAB_JOB_ALL;
+        gearman_return_t rc= gearman_packet_pack_header(&(worker->grab_job));
+        (void)(rc);
+        assert(gearman_success(rc));
+      }
       worker->options.grab_all= true;
     }
 
@@ -377,15 +390,21 @@ void gearman_worker_remove_options(gearman_worker_st *worker_shell,
 
     if (options & GEARMAN_WORKER_GRAB_UNIQ)
     {
-      worker->grab_job.command= GEARMAN_COMMAND_GRAB_JOB;
-      (void)gearman_packet_pack_header(&(worker->grab_job));
+      if (worker->grab_batch == 0)
+      {
+        worker->grab_job.command= GEARMAN_COMMAND_GRAB_JOB;
+        (void)gearman_packet_pack_header(&(worker->grab_job));
+      }
       worker->options.grab_uniq= false;
     }
 
     if (options & GEARMAN_WORKER_GRAB_ALL)
     {
-      worker->grab_job.command= GEARMAN_COMMAND_GRAB_JOB;
-      (void)gearman_packet_pack_header(&(worker->grab_job));
+      if (worker->grab_batch == 0)
+      {
+        worker->grab_job.command= GEARMAN_COMMAND_GRAB_JOB;
+        (void)gearman_packet_pack_header(&(worker->grab_job));
+      }
       worker->options.grab_all= false;
     }
 
@@ -789,23 +808,32 @@ gearman_job_st *gearman_worker_grab_job(gearman_worker_st *worker_shell,
             case GEARMAN_WORKER_STATE_GRAB_JOB_SEND:
             if (worker->con->socket_descriptor_is_valid() == false)
             {
+              worker->grab_pending= 0;
               continue;
             }
 
-            *ret_ptr= worker->con->send_packet(worker->grab_job, true);
-            if (gearman_failed(*ret_ptr))
+            // The rest of a batch is already on its way, no need to ask again.
+            if (worker->grab_pending)
             {
-              if (*ret_ptr == GEARMAN_IO_WAIT)
-              {
-                worker->state= GEARMAN_WORKER_STATE_GRAB_JOB_SEND;
-              }
-              else if (*ret_ptr == GEARMAN_LOST_CONNECTION)
+              *ret_ptr= GEARMAN_SUCCESS;
+            }
+            else
+            {
+              *ret_ptr= worker->con->send_packet(worker->grab_job, true);
+              if (gearman_failed(*ret_ptr))
               {
-                continue;
-              }
+                if (*ret_ptr == GEARMAN_IO_WAIT)
+                {
+                  worker->state= GEARMAN_WORKER_STATE_GRAB_JOB_SEND;
+                }
+                else if (*ret_ptr == GEARMAN_LOST_CONNECTION)
+                {
+                  continue;
+                }
 
-              assert(*ret_ptr != GEARMAN_MAX_RETURN);
-              return NULL;
+                assert(*ret_ptr != GEARMAN_MAX_RETURN);
+                return NULL;
+              }
             }
 
             if (worker->job() == NULL)
@@ -837,6 +865,7 @@ gearman_job_st *gearman_worker_grab_job(gearman_worker_st *worker_shell,
                   else
                   {
                     worker->job(NULL);
+                    worker->grab_pending= 0;
 
                     if (*ret_ptr == GEARMAN_LOST_CONNECTION)
                     {
@@ -857,6 +886,11 @@ gearman_job_st *gearman_worker_grab_job(gearman_worker_st *worker_shell,
                     worker->job()->impl()->assigned.command == GEARMAN_COMMAND_JOB_ASSIGN_ALL or
                     worker->job()->impl()->assigned.command == GEARMAN_COMMAND_JOB_ASSIGN_UNIQ)
                 {
+                  if (worker->grab_pending)
+                  {
+                    worker->grab_pending--;
+                  }
+
                   worker->job()->impl()->options.assigned_in_use= true;
                   worker->job()->impl()->con= worker->con;
                   worker->state= GEARMAN_WORKER_STATE_GRAB_JOB_SEND;
@@ -866,6 +900,25 @@ gearman_job_st *gearman_worker_grab_job(gearman_worker_st *worker_shell,
                   return job;
                 }
 
+                if (worker->job()->impl()->assigned.command == GEARMAN_COMMAND_JOB_ASSIGN_MULTI)
+                {
+                  char count_buffer[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+                  snprintf(count_buffer, sizeof(count_buffer), "%.*s",
+                           int(worker->job()->impl()->assigned.arg_size[0]),
+                           static_cast<const char *>(worker->job()->impl()->assigned.arg[0]));
+                  worker->grab_pending= uint32_t(strtoul(count_buffer, NULL, 10));
+                  gearman_packet_free(&(worker->job()->impl()->assigned));
+
+                  // The jobs of the batch follow the count, read the first one.
+                  if (worker->grab_pending)
+                  {
+                    continue;
+                  }
+
+                  no_job= true;
+                  break;
+                }
+
                 if (worker->job()->impl()->assigned.command == GEARMAN_COMMAND_NO_JOB or
                     worker->job()->impl()->assigned.command == GEARMAN_COMMAND_OPTION_RES)
                 {
@@ -1449,6 +1502,56 @@ gearman_id_t gearman_worker_id(gearman_worker_st *self)
   return gearman_universal_id(self->impl()->universal);
 }
 
+gearman_return_t gearman_worker_set_grab_batch(gearman_worker_st *worker_shell, uint32_t count)
+{
+  if (worker_shell and worker_shell->impl())
+  {
+    Worker* worker= worker_shell->impl();
+
+    gearman_command_t command= GEARMAN_COMMAND_GRAB_JOB;
+    if (worker->options.grab_all)
+    {
+      command= GEARMAN_COMMAND_GRAB_JOB_ALL;
+    }
+    else if (worker->options.grab_uniq)
+    {
+      command= GEARMAN_COMMAND_GRAB_JOB_UNIQ;
+    }
+
+    char count_buffer[GEARMAN_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+    const void *args[1]= { count_buffer };
+    size_t args_size[1];
+    args_size[0]= size_t(snprintf(count_buffer, sizeof(count_buffer), "%u", count));
+
+    gearman_packet_free(&(worker->grab_job));
+    worker->grab_batch= 0;
+
+    if (count > 1)
+    {
+      gearman_return_t ret= gearman_packet_create_args(worker->universal, worker->grab_job,
+                                                       GEARMAN_MAGIC_REQUEST, GEARMAN_COMMAND_GRAB_JOB_MULTI,
+                                                       args, args_size, 1);
+      if (gearman_success(ret))
+      {
+        worker->grab_batch= count;
+        return GEARMAN_SUCCESS;
+      }
+
+      // Keep a single grab around so the worker stays usable.
+      (void)gearman_packet_create_args(worker->universal, worker->grab_job,
+                                       GEARMAN_MAGIC_REQUEST, command,
+                                       NULL, NULL, 0);
+      return ret;
+    }
+
+    return gearman_packet_create_args(worker->universal, worker->grab_job,
+                                      GEARMAN_MAGIC_REQUEST, command,
+                                      NULL, NULL, 0);
+  }
+
+  return GEARMAN_INVALID_ARGUMENT;
+}
+
 gearman_return_t gearman_worker_set_identifier(gearman_worker_st *worker,
                                                const char *id, size_t id_size)
 {
@@ -48,6 +48,9 @@ using namespace org::gearmand;
 #include <libtest/test.hpp>
 using namespace libtest;
 
+#include <string>
+#include <vector>
+
 #include <libgearman/gearman.h>
 
 
@@ -261,6 +264,267 @@ static test_return_t gearadmin_status_with_jobs_TEST(void* object)
   return TEST_SUCCESS;
 }
 
+static test_return_t maxqueuebytes_TEST(void* object)
+{
+  cli::Context *context= (cli::Context*)object;
+
+  // Limits only apply to functions the server already knows about.
+  libgearman::Client client(context->port());
+  gearman_job_handle_t job_handle;
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_client_do_background(&client, __func__, NULL,
+                                                          test_literal_param("0123456789"),
+                                                          job_handle));
+
+  SimpleClient admin("localhost", context->port());
+  std::string response;
+  ASSERT_TRUE(admin.send_message("maxqueuebytes maxqueuebytes_TEST 64", response));
+  ASSERT_EQ(std::string("OK\r\n"), response);
+
+  std::vector<char> payload(100, 'x');
+  ASSERT_NEQ(GEARMAN_SUCCESS, gearman_client_do_background(&client, __func__, NULL,
+                                                           &payload[0], payload.size(),
+                                                           job_handle));
+
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_client_do_background(&client, __func__, NULL,
+                                                          test_literal_param("0123456789"),
+                                                          job_handle));
+
+  // Two jobs of ten bytes each.
+  bool found= false;
+  ASSERT_TRUE(admin.send_message("status", response));
+  while (response != ".\n")
+  {
+    if (response.compare(0, sizeof("maxqueuebytes_TEST\t") -1, "maxqueuebytes_TEST\t") == 0)
+    {
+      ASSERT_EQ(std::string("maxqueuebytes_TEST\t2\t0\t0\t20\t0\n"), response);
+      found= true;
+    }
+    ASSERT_TRUE(admin.response(response));
+  }
+  ASSERT_TRUE(found);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t maxrunning_TEST(void* object)
+{
+  cli::Context *context= (cli::Context*)object;
+
+  libgearman::Client client(context->port());
+  gearman_job_handle_t job_handle;
+  for (int x= 0; x < 2; ++x)
+  {
+    ASSERT_EQ(GEARMAN_SUCCESS, gearman_client_do_background(&client, __func__, NULL,
+                                                            test_literal_param("0123456789"),
+                                                            job_handle));
+  }
+
+  SimpleClient admin("localhost", context->port());
+  std::string response;
+  ASSERT_TRUE(admin.send_message("maxrunning maxrunning_TEST 1", response));
+  ASSERT_EQ(std::string("OK\r\n"), response);
+
+  libgearman::Worker first(context->port());
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_register(&first, __func__, 0));
+  libgearman::Worker second(context->port());
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_register(&second, __func__, 0));
+
+  gearman_return_t ret;
+  gearman_job_st *job= gearman_worker_grab_job(&first, NULL, &ret);
+  ASSERT_EQ(GEARMAN_SUCCESS, ret);
+  ASSERT_TRUE(job);
+
+  // The second job waits for the first one to finish.
+  ASSERT_NULL(gearman_worker_grab_job(&second, NULL, &ret));
+  ASSERT_EQ(GEARMAN_NO_JOBS, ret);
+
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_job_send_complete(job, NULL, 0));
+
+  // WORK_COMPLETE travels on another connection, so the server may see a GRAB first.
+  for (int x= 0; x < 100; ++x)
+  {
+    job= gearman_worker_grab_job(&second, NULL, &ret);
+    if (ret != GEARMAN_NO_JOBS)
+    {
+      break;
+    }
+    libtest::dream(0, 10000000);
+  }
+  ASSERT_EQ(GEARMAN_SUCCESS, ret);
+  ASSERT_TRUE(job);
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_job_send_complete(job, NULL, 0));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t ttl_TEST(void* object)
+{
+  cli::Context *context= (cli::Context*)object;
+
+  libgearman::Client client(context->port());
+  ASSERT_EQ(true, gearman_client_set_server_option(&client, test_literal_param("ttl=1")));
+
+  gearman_job_handle_t job_handle;
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_client_do_background(&client, __func__, NULL,
+                                                          test_literal_param("0123456789"),
+                                                          job_handle));
+
+  // Nothing ever takes the jobs, so the waiting client is failed.
+  size_t result_size;
+  gearman_return_t ret;
+  void *result= gearman_client_do(&client, __func__, NULL,
+                                  test_literal_param("0123456789"),
+                                  &result_size, &ret);
+  ASSERT_EQ(GEARMAN_WORK_FAIL, ret);
+  ASSERT_NULL(result);
+
+  SimpleClient admin("localhost", context->port());
+  std::string response;
+  bool found= false;
+  ASSERT_TRUE(admin.send_message("status", response));
+  while (response != ".\n")
+  {
+    if (response.compare(0, sizeof("ttl_TEST\t") -1, "ttl_TEST\t") == 0)
+    {
+      ASSERT_EQ(std::string("ttl_TEST\t0\t0\t0\t0\t2\n"), response);
+      found= true;
+    }
+    ASSERT_TRUE(admin.response(response));
+  }
+  ASSERT_TRUE(found);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t dead_letter_TEST(void* object)
+{
+  cli::Context *context= (cli::Context*)object;
+
+  libgearman::Client client(context->port());
+  gearman_job_handle_t job_handle;
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_client_do_background(&client, __func__, "dead_letter_unique",
+                                                          test_literal_param("0123456789"),
+                                                          job_handle));
+
+  SimpleClient admin("localhost", context->port());
+  std::string response;
+  ASSERT_TRUE(admin.send_message("retrybackoff dead_letter_TEST 2", response));
+  ASSERT_EQ(std::string("OK\r\n"), response);
+
+  // The first worker dies with the job, so the job waits before it runs again.
+  libgearman::Worker *worker= new libgearman::Worker(context->port());
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_register(&(*worker), __func__, 0));
+  gearman_return_t ret;
+  gearman_job_st *job= gearman_worker_grab_job(&(*worker), NULL, &ret);
+  ASSERT_EQ(GEARMAN_SUCCESS, ret);
+  ASSERT_TRUE(job);
+  gearman_job_free(job);
+  time_t died= time(NULL);
+  delete worker;
+
+  worker= new libgearman::Worker(context->port());
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_register(&(*worker), __func__, 0));
+  for (int x= 0; x < 500; ++x)
+  {
+    job= gearman_worker_grab_job(&(*worker), NULL, &ret);
+    if (ret != GEARMAN_NO_JOBS)
+    {
+      break;
+    }
+    libtest::dream(0, 10000000);
+  }
+  ASSERT_EQ(GEARMAN_SUCCESS, ret);
+  ASSERT_TRUE(job);
+  ASSERT_TRUE(time(NULL) -died >= 1);
+
+  // The second worker dies too, which was the last run the server allows.
+  gearman_job_free(job);
+  delete worker;
+
+  libgearman::Worker dead_letter_worker(context->port());
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_register(&dead_letter_worker, "dead_letter_TEST_failed", 0));
+  for (int x= 0; x < 500; ++x)
+  {
+    job= gearman_worker_grab_job(&dead_letter_worker, NULL, &ret);
+    if (ret != GEARMAN_NO_JOBS)
+    {
+      break;
+    }
+    libtest::dream(0, 10000000);
+  }
+  ASSERT_EQ(GEARMAN_SUCCESS, ret);
+  ASSERT_TRUE(job);
+
+  const char expected[]= "dead_letter_TEST\0dead_letter_unique\0" "2\0" "0123456789";
+  ASSERT_EQ(sizeof(expected) -1, gearman_job_workload_size(job));
+  ASSERT_EQ(0, memcmp(expected, gearman_job_workload(job), sizeof(expected) -1));
+  ASSERT_STREQ(job_handle, gearman_job_unique(job));
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_job_send_complete(job, NULL, 0));
+  gearman_job_free(job);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t worker_timeout_TEST(void* object)
+{
+  cli::Context *context= (cli::Context*)object;
+
+  libgearman::Client client(context->port());
+  gearman_job_handle_t job_handle;
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_client_do_background(&client, "worker_timeout_TEST_short", NULL,
+                                                          test_literal_param("short"), job_handle));
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_client_do_background(&client, "worker_timeout_TEST_long", NULL,
+                                                          test_literal_param("long"), job_handle));
+
+  // One worker holds a job of each function, the timeouts are per job.
+  libgearman::Worker slow_worker(context->port());
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_register(&slow_worker, "worker_timeout_TEST_short", 1000));
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_register(&slow_worker, "worker_timeout_TEST_long", 60000));
+  gearman_return_t ret;
+  gearman_job_st *held[2];
+  for (size_t x= 0; x < 2; ++x)
+  {
+    held[x]= gearman_worker_grab_job(&slow_worker, NULL, &ret);
+    ASSERT_EQ(GEARMAN_SUCCESS, ret);
+    ASSERT_TRUE(held[x]);
+  }
+
+  libgearman::Worker worker(context->port());
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_register(&worker, "worker_timeout_TEST_short", 0));
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_register(&worker, "worker_timeout_TEST_long", 0));
+  gearman_job_st *job= NULL;
+  for (int x= 0; x < 500; ++x)
+  {
+    job= gearman_worker_grab_job(&worker, NULL, &ret);
+    if (ret != GEARMAN_NO_JOBS)
+    {
+      break;
+    }
+    libtest::dream(0, 10000000);
+  }
+  ASSERT_EQ(GEARMAN_SUCCESS, ret);
+  ASSERT_TRUE(job);
+  ASSERT_STREQ("worker_timeout_TEST_short", gearman_job_function_name(job));
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_job_send_complete(job, NULL, 0));
+  gearman_job_free(job);
+
+  // The long job is still running on the first worker.
+  job= gearman_worker_grab_job(&worker, NULL, &ret);
+  ASSERT_EQ(GEARMAN_NO_JOBS, ret);
+  ASSERT_FALSE(job);
+
+  for (size_t x= 0; x < 2; ++x)
+  {
+    if (strcmp("worker_timeout_TEST_long", gearman_job_function_name(held[x])) == 0)
+    {
+      ASSERT_EQ(GEARMAN_SUCCESS, gearman_job_send_complete(held[x], NULL, 0));
+    }
+    gearman_job_free(held[x]);
+  }
+
+  return TEST_SUCCESS;
+}
+
 static test_return_t gearadmin_priority_status_TEST(void* object)
 {
   cli::Context *context= (cli::Context*)object;
@@ -422,6 +686,18 @@ static test_return_t server_SETUP(void *object)
   return TEST_SUCCESS;
 }
 
+static test_return_t dead_letter_SETUP(void* object)
+{
+  cli::Context *context= (cli::Context*)object;
+
+  const char *argv[]= { "--job-retries=2", "--dead-letter-function=dead_letter_TEST_failed", 0 };
+
+  context->port(libtest::get_free_port());
+  ASSERT_TRUE(server_startup(context->servers, "gearmand", context->port(), argv));
+
+  return TEST_SUCCESS;
+}
+
 
 test_st gearman_tests[] ={
   { "--help", 0, gearman_help_test },
@@ -444,6 +720,10 @@ test_st gearadmin_tests[] ={
   {"--status", 0, gearadmin_status_TEST},
   {"--priority-status", 0, gearadmin_priority_status_TEST},
   {"gearman_client_do_background(100) --status", 0, gearadmin_status_with_jobs_TEST},
+  {"maxqueuebytes", 0, maxqueuebytes_TEST},
+  {"maxrunning", 0, maxrunning_TEST},
+  {"ttl", 0, ttl_TEST},
+  {"worker timeout", 0, worker_timeout_TEST},
   {"--getpid", 0, gearadmin_getpid_test},
   {"--workers", 0, gearadmin_workers_test},
   {"--create-function and --drop-function", 0, gearadmin_create_drop_test},
@@ -451,6 +731,11 @@ test_st gearadmin_tests[] ={
   {0, 0, 0}
 };
 
+test_st gearadmin_job_retries_tests[] ={
+  {"retrybackoff and --dead-letter-function", 0, dead_letter_TEST},
+  {0, 0, 0}
+};
+
 test_st gearadmin_shutdown_tests[] ={
   {"--shutdown", 0, gearadmin_shutdown_test}, // shutdown test is a relict. It doesn't shut down the server anymore
   {0, 0, 0}
@@ -459,6 +744,7 @@ test_st gearadmin_shutdown_tests[] ={
 collection_st collection[] ={
   {"gearman", init_SETUP, init_TEARDOWN, gearman_tests},
   {"gearadmin", init_SETUP, init_TEARDOWN, gearadmin_tests},
+  {"gearadmin --job-retries", dead_letter_SETUP, init_TEARDOWN, gearadmin_job_retries_tests},
   {"gearadmin --shutdown", server_SETUP, init_TEARDOWN, gearadmin_shutdown_tests},
   {0, 0, 0, 0}
 };
@@ -40,3 +40,5 @@
 test_return_t gearman_client_do_background_basic(void *object);
 test_return_t gearman_client_do_high_background_basic(void *object);
 test_return_t gearman_client_do_low_background_basic(void *object);
+test_return_t gearman_client_do_background_batch_basic(void *object);
+test_return_t gearman_client_do_background_noreply_basic(void *object);
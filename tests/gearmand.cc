@@ -478,6 +478,96 @@ static test_return_t queue_test(void *)
   return TEST_SUCCESS;
 }
 
+static test_return_t background_replay_TEST(void *)
+{
+  const char *args[]= { "--check-args", "--background-replay", 0 };
+
+  ASSERT_EQ(EXIT_SUCCESS, exec_cmdline(gearmand_binary(), args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t snapshot_queue_TEST(void *)
+{
+  const char *args[]= { "--check-args", "--queue-type=snapshot", "--snapshot-file=var/tmp/gearmand.snapshot", 0 };
+
+  ASSERT_EQ(EXIT_SUCCESS, exec_cmdline(gearmand_binary(), args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t spill_file_TEST(void *)
+{
+  const char *args[]= { "--check-args", "--spill-file=var/tmp/gearmand.spill", "--memory-budget=1048576", "--spill-prefetch=4", 0 };
+
+  ASSERT_EQ(EXIT_SUCCESS, exec_cmdline(gearmand_binary(), args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t memory_budget_without_spill_file_TEST(void *)
+{
+  const char *args[]= { "--check-args", "--memory-budget=1048576", 0 };
+
+  ASSERT_EQ(EXIT_FAILURE, exec_cmdline(gearmand_binary(), args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t fair_scheduler_TEST(void *)
+{
+  const char *args[]= { "--check-args", "--scheduler=fair", "--priority-weights=8,4,1", "--priority-aging=60", 0 };
+
+  ASSERT_EQ(EXIT_SUCCESS, exec_cmdline(gearmand_binary(), args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t unknown_scheduler_TEST(void *)
+{
+  const char *args[]= { "--check-args", "--scheduler=lottery", 0 };
+
+  ASSERT_EQ(EXIT_FAILURE, exec_cmdline(gearmand_binary(), args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t bad_priority_weights_TEST(void *)
+{
+  const char *args[]= { "--check-args", "--scheduler=fair", "--priority-weights=8,0,1", 0 };
+
+  ASSERT_EQ(EXIT_FAILURE, exec_cmdline(gearmand_binary(), args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t max_running_TEST(void *)
+{
+  const char *args[]= { "--check-args", "--max-running=resize=4", "--max-running=upload=1", 0 };
+
+  ASSERT_EQ(EXIT_SUCCESS, exec_cmdline(gearmand_binary(), args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t bad_max_running_TEST(void *)
+{
+  const char *args[]= { "--check-args", "--max-running=resize", 0 };
+
+  ASSERT_EQ(EXIT_FAILURE, exec_cmdline(gearmand_binary(), args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t retry_backoff_TEST(void *)
+{
+  const char *args[]= { "--check-args", "--job-retries=4", "--retry-backoff=2", "--retry-backoff-max=60", "--dead-letter-function=failed", 0 };
+
+  ASSERT_EQ(EXIT_SUCCESS, exec_cmdline(gearmand_binary(), args, true));
+
+  return TEST_SUCCESS;
+}
+
 static test_return_t long_job_retries_test(void *)
 {
   const char *args[]= { "--check-args", "--job-retries=4", 0 };
@@ -662,10 +752,20 @@ test_st gearmand_option_tests[] ={
   {"-w", 0, short_worker_wakeup_test},
   {"--protocol=", 0, protocol_test},
   {"--queue-type=", 0, queue_test},
+  {"--background-replay", 0, background_replay_TEST},
+  {"--queue-type=snapshot", 0, snapshot_queue_TEST},
+  {"--spill-file", 0, spill_file_TEST},
+  {"--memory-budget without --spill-file", 0, memory_budget_without_spill_file_TEST},
+  {"--scheduler=fair", 0, fair_scheduler_TEST},
+  {"--scheduler=lottery", 0, unknown_scheduler_TEST},
+  {"--priority-weights=8,0,1", 0, bad_priority_weights_TEST},
+  {"--max-running=", 0, max_running_TEST},
+  {"--max-running=resize", 0, bad_max_running_TEST},
   {"--job-retries=", 0, long_job_retries_test},
   {"-hashtable-buckets", 0, hashtable_buckets_TEST},
   {"--job-handle-prefix=", 0, job_handle_prefix_TEST},
   {"-j", 0, short_job_retries_test},
+  {"--retry-backoff=", 0, retry_backoff_TEST},
   {"--config-file=etc/gearmand.conf no file present", 0, config_file_TEST },
   {"--config-file", 0, config_file_DEFAULT_TEST },
   {"--config-file=etc/grmandfoo.conf", 0, config_file_FAIL_TEST },
@@ -1637,6 +1637,12 @@ static test_return_t gearman_client_do_low_background_GEARMAN_INVALID_ARGUMENT_T
   return TEST_SUCCESS;
 }
 
+static test_return_t gearman_client_do_background_batch_GEARMAN_INVALID_ARGUMENT_TEST(void*)
+{
+  ASSERT_EQ(GEARMAN_INVALID_ARGUMENT, gearman_client_do_background_batch(NULL, NULL, 0));
+  return TEST_SUCCESS;
+}
+
 static test_return_t gearman_client_job_status_GEARMAN_INVALID_ARGUMENT_TEST(void*)
 {
   ASSERT_EQ(GEARMAN_INVALID_ARGUMENT, gearman_client_job_status(NULL, NULL, NULL, NULL, NULL, NULL));
@@ -2179,6 +2185,7 @@ test_st gearman_client_st_GEARMAN_INVALID_ARGUMENT_TESTS[] ={
   {"gearman_client_do_background()", 0, gearman_client_do_background_GEARMAN_INVALID_ARGUMENT_TEST },
   {"gearman_client_do_high_background()", 0, gearman_client_do_high_background_GEARMAN_INVALID_ARGUMENT_TEST },
   {"gearman_client_do_low_background()", 0, gearman_client_do_low_background_GEARMAN_INVALID_ARGUMENT_TEST },
+  {"gearman_client_do_background_batch()", 0, gearman_client_do_background_batch_GEARMAN_INVALID_ARGUMENT_TEST },
   {"gearman_client_job_status()", 0, gearman_client_job_status_GEARMAN_INVALID_ARGUMENT_TEST },
   {"gearman_client_unique_status()", 0, gearman_client_unique_status_GEARMAN_INVALID_ARGUMENT_TEST },
   {"gearman_client_add_task_status_by_unique()", 0, gearman_client_add_task_status_by_unique_GEARMAN_INVALID_ARGUMENT_TEST },
@@ -2391,6 +2398,8 @@ test_st gearman_client_do_background_tests[] ={
   {"gearman_client_do_background()", 0, gearman_client_do_background_basic },
   {"gearman_client_do_high_background()", 0, gearman_client_do_high_background_basic },
   {"gearman_client_do_low_background()", 0, gearman_client_do_low_background_basic },
+  {"gearman_client_do_background_batch()", 0, gearman_client_do_background_batch_basic },
+  {"gearman_client_do_background_noreply()", 0, gearman_client_do_background_noreply_basic },
   {0, 0, 0}
 };
 
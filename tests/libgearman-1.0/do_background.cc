@@ -101,3 +101,58 @@ test_return_t gearman_client_do_low_background_basic(void *object)
 
   return TEST_SUCCESS;
 }
+
+test_return_t gearman_client_do_background_batch_basic(void *object)
+{
+  gearman_client_st *client= (gearman_client_st *)object;
+  const char *worker_function= (const char *)gearman_client_context(client);
+
+  gearman_batch_job_t jobs[3];
+  memset(jobs, 0, sizeof(jobs));
+  for (size_t x= 0; x < 3; ++x)
+  {
+    jobs[x].function_name= worker_function;
+    jobs[x].workload= "foobar";
+    jobs[x].workload_size= strlen("foobar");
+    jobs[x].priority= GEARMAN_JOB_PRIORITY_NORMAL;
+  }
+  jobs[2].priority= GEARMAN_JOB_PRIORITY_HIGH;
+
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_client_do_background_batch(client, jobs, 3));
+  for (size_t x= 0; x < 3; ++x)
+  {
+    ASSERT_EQ(GEARMAN_SUCCESS, jobs[x].ret);
+    ASSERT_TRUE(jobs[x].job_handle[0]);
+  }
+  ASSERT_TRUE(strcmp(jobs[0].job_handle, jobs[1].job_handle));
+  ASSERT_TRUE(strcmp(jobs[1].job_handle, jobs[2].job_handle));
+
+  jobs[1].priority= GEARMAN_JOB_PRIORITY_MAX;
+  ASSERT_EQ(GEARMAN_INVALID_ARGUMENT, gearman_client_do_background_batch(client, jobs, 3));
+
+  return TEST_SUCCESS;
+}
+
+test_return_t gearman_client_do_background_noreply_basic(void *object)
+{
+  gearman_client_st *client= (gearman_client_st *)object;
+  const char *worker_function= (const char *)gearman_client_context(client);
+
+  uint64_t accepted;
+  uint64_t refused;
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_client_noreply_ack(client, &accepted, &refused));
+
+  for (size_t x= 0; x < 3; ++x)
+  {
+    ASSERT_EQ(GEARMAN_SUCCESS, gearman_client_do_background_noreply(client, worker_function, NULL,
+                                                                    test_literal_param("foobar")));
+  }
+
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_client_noreply_ack(client, &accepted, &refused));
+  ASSERT_EQ(uint64_t(3), accepted);
+  ASSERT_EQ(uint64_t(0), refused);
+
+  ASSERT_EQ(GEARMAN_INVALID_ARGUMENT, gearman_client_do_background_noreply(client, NULL, NULL, NULL, 0));
+
+  return TEST_SUCCESS;
+}
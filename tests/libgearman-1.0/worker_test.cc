@@ -1636,6 +1636,56 @@ static test_return_t gearman_worker_set_identifier_TEST(void *)
   return TEST_SUCCESS;
 }
 
+static void *count_worker(gearman_job_st *, void *context,
+                          size_t *result_size, gearman_return_t *ret_ptr)
+{
+  uint32_t *count= (uint32_t *)context;
+  (*count)++;
+  *result_size= 0;
+  *ret_ptr= GEARMAN_SUCCESS;
+
+  return NULL;
+}
+
+static test_return_t gearman_worker_set_grab_batch_TEST(void *)
+{
+  char function_name[GEARMAN_FUNCTION_MAX_SIZE];
+  snprintf(function_name, GEARMAN_FUNCTION_MAX_SIZE, "_%s%d", __func__, int(random())); 
+
+  {
+    libgearman::Client client(libtest::default_port());
+
+    for (uint32_t x= 0; x < 5; ++x)
+    {
+      ASSERT_EQ(GEARMAN_SUCCESS,
+                gearman_client_do_background(&client, function_name, NULL, test_literal_param("batch"), NULL));
+    }
+  }
+
+  libgearman::Worker worker(libtest::default_port());
+
+  uint32_t count= 0;
+  ASSERT_EQ(GEARMAN_SUCCESS,
+            gearman_worker_add_function(&worker, function_name, 0, count_worker, &count));
+
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_set_grab_batch(&worker, 3));
+  ASSERT_EQ(3U, worker->impl()->grab_batch);
+
+  // Two round trips hand out all five jobs.
+  for (uint32_t x= 0; x < 5; ++x)
+  {
+    ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_work(&worker));
+  }
+  ASSERT_EQ(5U, count);
+  ASSERT_EQ(0U, worker->impl()->grab_pending);
+
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_worker_set_grab_batch(&worker, 1));
+  ASSERT_EQ(0U, worker->impl()->grab_batch);
+  ASSERT_EQ(GEARMAN_COMMAND_GRAB_JOB_ALL, worker->impl()->grab_job.command);
+
+  return TEST_SUCCESS;
+}
+
 static test_return_t gearman_worker_add_options_GEARMAN_WORKER_GRAB_UNIQ_worker_work(void *)
 {
   libgearman::Worker worker(libtest::default_port());
@@ -1891,6 +1941,7 @@ test_st worker_TESTS[] ={
   {"gearman_worker_add_options(GEARMAN_WORKER_GRAB_UNIQ)", 0, gearman_worker_add_options_GEARMAN_WORKER_GRAB_UNIQ },
   {"gearman_worker_add_options(GEARMAN_WORKER_GRAB_UNIQ) worker_work()", 0, gearman_worker_add_options_GEARMAN_WORKER_GRAB_UNIQ_worker_work },
   {"gearman_worker_set_timeout(2) with failover", 0, gearman_worker_set_timeout_FAILOVER_TEST },
+  {"gearman_worker_set_grab_batch()", 0, gearman_worker_set_grab_batch_TEST },
   {"gearman_return_t worker return coverage", 0, error_return_TEST },
   {"gearman_return_t GEARMAN_FAIL worker coverage", 0, GEARMAN_FAIL_return_TEST },
   {"gearman_return_t GEARMAN_ERROR worker coverage", 0, GEARMAN_ERROR_return_TEST },
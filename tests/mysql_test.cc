@@ -65,6 +65,7 @@ static test_return_t gearmand_basic_option_test(void *)
     "--mysql-password=mysql",
     "--mysql-db=gearman",
     "--mysql-table=gearman",
+    "--mysql-batch-size=64",
     0 };
 
   ASSERT_EQ(EXIT_SUCCESS, exec_cmdline(gearmand_binary(), args, true));
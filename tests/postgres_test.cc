@@ -62,6 +62,7 @@ static test_return_t gearmand_basic_option_test(void *)
     "--queue-type=Postgres",
     "--libpq-conninfo", "host=localhost dbname=gearman",
     "--libpq-table=gearman",
+    "--libpq-batch-size=64",
     0 };
 
   ASSERT_EQ(EXIT_SUCCESS, exec_cmdline(gearmand_binary(), args, true));
@@ -43,6 +43,8 @@ using namespace libtest;
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <vector>
 
 #define GEARMAN_CORE
 #include "libgearman/common.h"
@@ -187,12 +189,308 @@ static test_return_t GEARMAN_COMMAND_ECHO_REQ_overrun_TEST(void *)
   return TEST_SUCCESS;
 }
 
+static test_return_t _send_command(gearman_universal_st& universal, gearman_connection_st *connection,
+                                   gearman_command_t command,
+                                   const char *first= NULL, const char *second= NULL, const char *third= NULL)
+{
+  const char *values[]= { first, second, third };
+  const void *args[3];
+  size_t args_size[3];
+  size_t args_count= 0;
+  for (; args_count < 3 and values[args_count]; ++args_count)
+  {
+    args[args_count]= values[args_count];
+    args_size[args_count]= strlen(values[args_count]) +1;
+  }
+
+  // The last argument is not NULL terminated.
+  if (args_count)
+  {
+    args_size[args_count -1]--;
+  }
+
+  gearman_packet_st message;
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_packet_create_args(universal, message, GEARMAN_MAGIC_REQUEST, command,
+                                                        args, args_size, args_count));
+  ASSERT_EQ(GEARMAN_SUCCESS, connection->send_packet(message, true));
+  gearman_packet_free(&message);
+
+  return TEST_SUCCESS;
+}
+
+static gearman_command_t _recv_command(gearman_connection_st *connection, std::string& job_handle)
+{
+  gearman_return_t ret;
+  gearman_packet_st recv_message;
+  if (connection->receiving(recv_message, ret, true) == NULL or gearman_failed(ret))
+  {
+    return GEARMAN_COMMAND_MAX;
+  }
+
+  gearman_command_t command= recv_message.command;
+  if (command == GEARMAN_COMMAND_JOB_ASSIGN or
+      command == GEARMAN_COMMAND_JOB_ASSIGN_UNIQ or
+      command == GEARMAN_COMMAND_JOB_ASSIGN_ALL)
+  {
+    job_handle= recv_message.arg[0];
+  }
+  else if (command == GEARMAN_COMMAND_JOB_ASSIGN_MULTI)
+  {
+    // Hand back the job count instead.
+    job_handle.assign(recv_message.arg[0], recv_message.arg_size[0]);
+  }
+  else if (command == GEARMAN_COMMAND_JOB_CREATED_BATCH)
+  {
+    // Hand back all of the NULL terminated job handles.
+    job_handle.assign(recv_message.value(), recv_message.size());
+  }
+  else if (command == GEARMAN_COMMAND_NOREPLY_ACK_RES)
+  {
+    // Hand back "accepted refused".
+    job_handle.assign(recv_message.arg[0], recv_message.arg_size[0] -1);
+    job_handle+= ' ';
+    job_handle.append(recv_message.arg[1], recv_message.arg_size[1]);
+  }
+  gearman_packet_free(&recv_message);
+
+  return command;
+}
+
+static test_return_t GEARMAN_COMMAND_OPTION_REQ_capacity_TEST(void *)
+{
+  gearman_universal_st universal;
+  gearman_set_log_fn(universal, error_logger, NULL, GEARMAN_VERBOSE_ERROR);
+  universal.ssl(libtest::is_ssl());
+
+  gearman_connection_st *client;
+  ASSERT_TRUE(client= gearman_connection_create(universal, GEARMAN_DEFAULT_TCP_HOST, libtest::default_port()));
+
+  std::string job_handle;
+  for (int x= 0; x < 3; ++x)
+  {
+    ASSERT_EQ(TEST_SUCCESS, _send_command(universal, client, GEARMAN_COMMAND_SUBMIT_JOB_BG, __func__, "", "x"));
+    ASSERT_EQ(GEARMAN_COMMAND_JOB_CREATED, _recv_command(client, job_handle));
+  }
+
+  gearman_connection_st *worker;
+  ASSERT_TRUE(worker= gearman_connection_create(universal, GEARMAN_DEFAULT_TCP_HOST, libtest::default_port()));
+
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_OPTION_REQ, "capacity=0"));
+  ASSERT_EQ(GEARMAN_COMMAND_ERROR, _recv_command(worker, job_handle));
+
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_OPTION_REQ, "capacity=2"));
+  ASSERT_EQ(GEARMAN_COMMAND_OPTION_RES, _recv_command(worker, job_handle));
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_CAN_DO, __func__));
+
+  // One GRAB_JOB fills both slots.
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_GRAB_JOB));
+  std::string first_handle;
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN, _recv_command(worker, first_handle));
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN, _recv_command(worker, job_handle));
+
+  // The third job is pushed once a slot frees up.
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_WORK_COMPLETE, first_handle.c_str(), ""));
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN, _recv_command(worker, job_handle));
+
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_GRAB_JOB));
+  ASSERT_EQ(GEARMAN_COMMAND_NO_JOB, _recv_command(worker, job_handle));
+
+  delete worker;
+  delete client;
+  gearman_universal_free(universal);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t GEARMAN_COMMAND_GRAB_JOB_MULTI_TEST(void *)
+{
+  gearman_universal_st universal;
+  gearman_set_log_fn(universal, error_logger, NULL, GEARMAN_VERBOSE_ERROR);
+  universal.ssl(libtest::is_ssl());
+
+  gearman_connection_st *client;
+  ASSERT_TRUE(client= gearman_connection_create(universal, GEARMAN_DEFAULT_TCP_HOST, libtest::default_port()));
+
+  std::string job_handle;
+  for (int x= 0; x < 3; ++x)
+  {
+    ASSERT_EQ(TEST_SUCCESS, _send_command(universal, client, GEARMAN_COMMAND_SUBMIT_JOB_BG, __func__, "", "x"));
+    ASSERT_EQ(GEARMAN_COMMAND_JOB_CREATED, _recv_command(client, job_handle));
+  }
+
+  gearman_connection_st *worker;
+  ASSERT_TRUE(worker= gearman_connection_create(universal, GEARMAN_DEFAULT_TCP_HOST, libtest::default_port()));
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_CAN_DO, __func__));
+
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_GRAB_JOB_MULTI, "0"));
+  ASSERT_EQ(GEARMAN_COMMAND_ERROR, _recv_command(worker, job_handle));
+
+  // The count comes first, then the jobs.
+  std::string count;
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_GRAB_JOB_MULTI, "2"));
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN_MULTI, _recv_command(worker, count));
+  ASSERT_EQ(std::string("2"), count);
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN_UNIQ, _recv_command(worker, job_handle));
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN_UNIQ, _recv_command(worker, job_handle));
+
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_GRAB_JOB_MULTI, "5"));
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN_MULTI, _recv_command(worker, count));
+  ASSERT_EQ(std::string("1"), count);
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN_UNIQ, _recv_command(worker, job_handle));
+
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_GRAB_JOB_MULTI, "5"));
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN_MULTI, _recv_command(worker, count));
+  ASSERT_EQ(std::string("0"), count);
+
+  delete worker;
+  delete client;
+  gearman_universal_free(universal);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t _send_batch(gearman_universal_st& universal, gearman_connection_st *connection,
+                                 const char *count, const std::string& records)
+{
+  const void *args[]= { count, records.c_str() };
+  size_t args_size[]= { strlen(count) +1, records.size() };
+
+  gearman_packet_st message;
+  ASSERT_EQ(GEARMAN_SUCCESS, gearman_packet_create_args(universal, message, GEARMAN_MAGIC_REQUEST,
+                                                        GEARMAN_COMMAND_SUBMIT_JOB_BATCH,
+                                                        args, args_size, 2));
+  ASSERT_EQ(GEARMAN_SUCCESS, connection->send_packet(message, true));
+  gearman_packet_free(&message);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t GEARMAN_COMMAND_SUBMIT_JOB_BATCH_TEST(void *)
+{
+  gearman_universal_st universal;
+  gearman_set_log_fn(universal, error_logger, NULL, GEARMAN_VERBOSE_ERROR);
+  universal.ssl(libtest::is_ssl());
+
+  gearman_connection_st *client;
+  ASSERT_TRUE(client= gearman_connection_create(universal, GEARMAN_DEFAULT_TCP_HOST, libtest::default_port()));
+
+  std::string function(__func__);
+  std::string records;
+  records+= function +'\0' +'\0' +"1" +'\0' +"1" +'\0' +"a";
+  records+= function +'\0' +"same" +'\0' +"2" +'\0' +"2" +'\0' +"bb";
+  records+= function +'\0' +"same" +'\0' +"2" +'\0' +"2" +'\0' +"bb";
+  records+= function +'\0' +'\0' +"0" +'\0' +"0" +'\0';
+
+  // The handles come back in the order of the jobs, a repeated unique
+  // gets the handle of the job it matches.
+  std::string handles;
+  ASSERT_EQ(TEST_SUCCESS, _send_batch(universal, client, "4", records));
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_CREATED_BATCH, _recv_command(client, handles));
+  std::vector<std::string> handle_list;
+  for (size_t start= 0, end; (end= handles.find('\0', start)) != std::string::npos; start= end +1)
+  {
+    handle_list.push_back(handles.substr(start, end -start));
+  }
+  ASSERT_EQ(size_t(4), handle_list.size());
+  ASSERT_FALSE(handle_list[0].empty());
+  ASSERT_EQ(handle_list[1], handle_list[2]);
+  ASSERT_NEQ(handle_list[0], handle_list[3]);
+
+  ASSERT_EQ(TEST_SUCCESS, _send_batch(universal, client, "2", records.substr(0, records.find("a") +1)));
+  ASSERT_EQ(GEARMAN_COMMAND_ERROR, _recv_command(client, handles));
+
+  ASSERT_EQ(TEST_SUCCESS, _send_batch(universal, client, "1", records.substr(0, records.find("a"))));
+  ASSERT_EQ(GEARMAN_COMMAND_ERROR, _recv_command(client, handles));
+
+  // Three distinct jobs were queued, the high priority one first.
+  gearman_connection_st *worker;
+  ASSERT_TRUE(worker= gearman_connection_create(universal, GEARMAN_DEFAULT_TCP_HOST, libtest::default_port()));
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_CAN_DO, __func__));
+
+  std::string job_handle;
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_GRAB_JOB_MULTI, "10"));
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN_MULTI, _recv_command(worker, job_handle));
+  ASSERT_EQ(std::string("3"), job_handle);
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN_UNIQ, _recv_command(worker, job_handle));
+  ASSERT_EQ(handle_list[3], job_handle);
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN_UNIQ, _recv_command(worker, job_handle));
+  ASSERT_EQ(handle_list[0], job_handle);
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN_UNIQ, _recv_command(worker, job_handle));
+  ASSERT_EQ(handle_list[1], job_handle);
+
+  delete worker;
+  delete client;
+  gearman_universal_free(universal);
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY_TEST(void *)
+{
+  gearman_universal_st universal;
+  gearman_set_log_fn(universal, error_logger, NULL, GEARMAN_VERBOSE_ERROR);
+  universal.ssl(libtest::is_ssl());
+
+  gearman_connection_st *client;
+  ASSERT_TRUE(client= gearman_connection_create(universal, GEARMAN_DEFAULT_TCP_HOST, libtest::default_port()));
+
+  std::string too_large(GEARMAN_UNIQUE_SIZE +1, 'x');
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, client, GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY, __func__, "first", "x"));
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, client, GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY, __func__, too_large.c_str(), "x"));
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, client, GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY, __func__, "second", "x"));
+
+  // Nothing came back for the jobs, the first reply is the ack.
+  std::string counts;
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, client, GEARMAN_COMMAND_NOREPLY_ACK_REQ));
+  ASSERT_EQ(GEARMAN_COMMAND_NOREPLY_ACK_RES, _recv_command(client, counts));
+  ASSERT_EQ(std::string("2 1"), counts);
+
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, client, GEARMAN_COMMAND_NOREPLY_ACK_REQ));
+  ASSERT_EQ(GEARMAN_COMMAND_NOREPLY_ACK_RES, _recv_command(client, counts));
+  ASSERT_EQ(std::string("0 0"), counts);
+
+  gearman_connection_st *worker;
+  ASSERT_TRUE(worker= gearman_connection_create(universal, GEARMAN_DEFAULT_TCP_HOST, libtest::default_port()));
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_CAN_DO, __func__));
+
+  std::string job_handle;
+  ASSERT_EQ(TEST_SUCCESS, _send_command(universal, worker, GEARMAN_COMMAND_GRAB_JOB_MULTI, "10"));
+  ASSERT_EQ(GEARMAN_COMMAND_JOB_ASSIGN_MULTI, _recv_command(worker, job_handle));
+  ASSERT_EQ(std::string("2"), job_handle);
+
+  delete worker;
+  delete client;
+  gearman_universal_free(universal);
+
+  return TEST_SUCCESS;
+}
+
 test_st GEARMAN_COMMAND_ECHO_REQ_TESTS[] ={
   {"GEARMAN_COMMAND_ECHO_REQ check", 0, GEARMAN_COMMAND_ECHO_REQ_TEST },
   {"GEARMAN_COMMAND_ECHO_REQ overrun", 0, GEARMAN_COMMAND_ECHO_REQ_overrun_TEST },
   {0, 0, 0}
 };
 
+test_st GEARMAN_COMMAND_OPTION_REQ_TESTS[] ={
+  {"GEARMAN_COMMAND_OPTION_REQ capacity", 0, GEARMAN_COMMAND_OPTION_REQ_capacity_TEST },
+  {0, 0, 0}
+};
+
+test_st GEARMAN_COMMAND_GRAB_JOB_MULTI_TESTS[] ={
+  {"GEARMAN_COMMAND_GRAB_JOB_MULTI check", 0, GEARMAN_COMMAND_GRAB_JOB_MULTI_TEST },
+  {0, 0, 0}
+};
+
+test_st GEARMAN_COMMAND_SUBMIT_JOB_BATCH_TESTS[] ={
+  {"GEARMAN_COMMAND_SUBMIT_JOB_BATCH check", 0, GEARMAN_COMMAND_SUBMIT_JOB_BATCH_TEST },
+  {0, 0, 0}
+};
+
+test_st GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY_TESTS[] ={
+  {"GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY check", 0, GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY_TEST },
+  {0, 0, 0}
+};
+
 test_st GEARMAN_COMMAND_WORK_EXCEPTION_TESTS[] ={
 #if 0
   {"GEARMAN_COMMAND_WORK_EXCEPTION check", 0, GEARMAN_COMMAND_WORK_EXCEPTION_TEST },
@@ -202,6 +500,10 @@ test_st GEARMAN_COMMAND_WORK_EXCEPTION_TESTS[] ={
 
 collection_st collection[] ={
   {"GEARMAN_COMMAND_ECHO_REQ", 0, 0, GEARMAN_COMMAND_ECHO_REQ_TESTS},
+  {"GEARMAN_COMMAND_OPTION_REQ", 0, 0, GEARMAN_COMMAND_OPTION_REQ_TESTS},
+  {"GEARMAN_COMMAND_GRAB_JOB_MULTI", 0, 0, GEARMAN_COMMAND_GRAB_JOB_MULTI_TESTS},
+  {"GEARMAN_COMMAND_SUBMIT_JOB_BATCH", 0, 0, GEARMAN_COMMAND_SUBMIT_JOB_BATCH_TESTS},
+  {"GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY", 0, 0, GEARMAN_COMMAND_SUBMIT_JOB_NOREPLY_TESTS},
   {"GEARMAN_COMMAND_WORK_EXCEPTION", 0, 0, GEARMAN_COMMAND_WORK_EXCEPTION_TESTS},
   {0, 0, 0, 0}
 };
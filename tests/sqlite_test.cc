@@ -439,7 +439,8 @@ static test_return_t lp_1087654_TEST(void* object)
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wstack-protector"
-static test_return_t queue_restart_TEST(Context const* test, const int32_t inserted_jobs, uint32_t timeout)
+static test_return_t queue_restart_TEST(Context const* test, const int32_t inserted_jobs, uint32_t timeout,
+                                        bool background_replay= false)
 {
   SKIP_IF(HAVE_UUID_UUID_H != 1);
 
@@ -456,6 +457,12 @@ static test_return_t queue_restart_TEST(Context const* test, const int32_t inser
     sql_buffer,
     0 };
 
+  const char *restart_argv[]= {
+    "--queue-type=libsqlite3", 
+    sql_buffer,
+    background_replay ? "--background-replay" : 0,
+    0 };
+
   {
     in_port_t first_port= libtest::get_free_port();
 
@@ -523,7 +530,7 @@ static test_return_t queue_restart_TEST(Context const* test, const int32_t inser
   {
     in_port_t first_port= libtest::get_free_port();
 
-    ASSERT_TRUE(server_startup(servers, "gearmand", first_port, argv));
+    ASSERT_TRUE(server_startup(servers, "gearmand", first_port, restart_argv));
 
     if (timeout)
     {
@@ -604,6 +611,14 @@ static test_return_t lp_1054377x200_TEST(void* object)
   return queue_restart_TEST(test, 200, 200);
 }
 
+static test_return_t background_replay_TEST(void* object)
+{
+  Context *test= (Context *)object;
+  ASSERT_TRUE(test);
+
+  return queue_restart_TEST(test, 50, 0, true);
+}
+
 static test_return_t skip_SETUP(void*)
 {
   SKIP_IF(true);
@@ -653,6 +668,7 @@ test_st queue_restart_TESTS[] ={
   {"lp:1054377", 0, lp_1054377_TEST },
   {"lp:1054377 x 200", 0, lp_1054377x200_TEST },
   {"lp:1087654", 0, lp_1087654_TEST },
+  {"--background-replay", 0, background_replay_TEST },
   {0, 0, 0}
 };
 
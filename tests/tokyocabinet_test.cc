@@ -70,6 +70,7 @@ static test_return_t gearmand_basic_option_test(void *)
     "--queue-type=libtokyocabinet",
     "--libtokyocabinet-file=var/tmp/gearman_basic.tcb",
     "--libtokyocabinet-optimize", 
+    "--libtokyocabinet-sync=100ms",
     0 };
 
   unlink("var/tmp/gearman.tcb");